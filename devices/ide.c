@@ -6,16 +6,19 @@
 #include "devices/block.h"
 #include "devices/partition.h"
 #include "devices/timer.h"
+#include "threads/init.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
-#define reg_error(CHANNEL) ((CHANNEL)->reg_base + 1)    /* Error. */
+#define reg_error(CHANNEL) ((CHANNEL)->reg_base + 1)    /* Error (r/o). */
+#define reg_features(CHANNEL) reg_error (CHANNEL)       /* Features (w/o). */
 #define reg_nsect(CHANNEL) ((CHANNEL)->reg_base + 2)    /* Sector Count. */
 #define reg_lbal(CHANNEL) ((CHANNEL)->reg_base + 3)     /* LBA 0:7. */
 #define reg_lbam(CHANNEL) ((CHANNEL)->reg_base + 4)     /* LBA 15:8. */
@@ -34,6 +37,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +53,11 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_SET_FEATURES 0xef           /* SET FEATURES. */
+#define CMD_FLUSH_CACHE 0xe7            /* FLUSH CACHE. */
+
+/* SET FEATURES subcommands, written to the Features register. */
+#define FEAT_ENABLE_WCACHE 0x02         /* Enable volatile write cache. */
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +66,11 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool write_cache;           /* Volatile write cache enabled? */
+
+    /* Identity, found by probing and kept until registration. */
+    block_sector_t capacity;    /* Size in sectors. */
+    char extra_info[128];       /* Model and serial number. */
   };
 
 /* An ATA channel (aka controller).
@@ -71,22 +85,33 @@ struct channel
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    struct semaphore probe_done;        /* Up'd when probing finishes. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
+/* Most sectors transferred by one READ or WRITE SECTOR command.
+   A sector count register value of 0 means this many. */
+#define MAX_SECTORS_PER_CMD 256
+
 /* We support the two "legacy" ATA channels found in a standard PC. */
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+static thread_func probe_channel;
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
+static bool too_large (block_sector_t capacity);
+static void register_ata_device (struct ata_disk *);
+static void enable_write_cache (struct ata_disk *, const uint16_t id[]);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
+static bool issue_nondata_command (struct ata_disk *, uint8_t command,
+                                   uint8_t features);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
@@ -97,7 +122,13 @@ static void select_device_wait (const struct ata_disk *);
 
 static void interrupt_handler (struct intr_frame *);
 
-/* Initialize the disk subsystem and detect disks. */
+/* Initialize the disk subsystem and start detecting disks.
+
+   Resetting a channel takes at least 150 ms, and much longer
+   when a device is slow to come out of reset, so each channel is
+   probed by its own thread while the caller goes on with other
+   work.  Call ide_init_finish() to wait for the probes and
+   register the disks found. */
 void
 ide_init (void) 
 {
@@ -126,6 +157,7 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      sema_init (&c->probe_done, 0);
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,22 +168,36 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->write_cache = false;
         }
 
       /* Register interrupt handler. */
       intr_register_ext (c->irq, interrupt_handler, c->name);
 
-      /* Reset hardware. */
-      reset_channel (c);
+      /* Start probing. */
+      thread_create (c->name, PRI_DEFAULT, probe_channel, c);
+    }
+}
+
+/* Waits for the threads started by ide_init() to finish probing
+   and registers the disks they found with the block device layer.
+   Registration happens here, in channel order, so that disks are
+   registered, scanned for partitions and reported in the same
+   order however the probes interleave. */
+void
+ide_init_finish (void) 
+{
+  size_t chan_no;
 
-      /* Distinguish ATA hard disks from other devices. */
-      if (check_device_type (&c->devices[0]))
-        check_device_type (&c->devices[1]);
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      struct channel *c = &channels[chan_no];
+      int dev_no;
 
-      /* Read hard disk identity information. */
+      sema_down (&c->probe_done);
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
-          identify_ata_device (&c->devices[dev_no]);
+          register_ata_device (&c->devices[dev_no]);
     }
 }
 
@@ -159,6 +205,31 @@ ide_init (void)
 
 static char *descramble_ata_string (char *, int size);
 
+/* Thread function that detects and identifies the disks on
+   channel C_, then signals ide_init_finish(). */
+static void
+probe_channel (void *c_) 
+{
+  struct channel *c = c_;
+  struct boot_phase *phase = boot_phase_begin (c->name);
+  int dev_no;
+
+  /* Reset hardware. */
+  reset_channel (c);
+
+  /* Distinguish ATA hard disks from other devices. */
+  if (check_device_type (&c->devices[0]))
+    check_device_type (&c->devices[1]);
+
+  /* Read hard disk identity information. */
+  for (dev_no = 0; dev_no < 2; dev_no++)
+    if (c->devices[dev_no].is_ata)
+      identify_ata_device (&c->devices[dev_no]);
+
+  boot_phase_end (phase);
+  sema_up (&c->probe_done);
+}
+
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
 static void
@@ -254,17 +325,13 @@ check_device_type (struct ata_disk *d)
 }
 
 /* Sends an IDENTIFY DEVICE command to disk D and reads the
-   response.  Registers the disk with the block device
-   layer. */
+   response into D's capacity and extra_info members. */
 static void
 identify_ata_device (struct ata_disk *d) 
 {
   struct channel *c = d->channel;
   char id[BLOCK_SECTOR_SIZE];
-  block_sector_t capacity;
   char *model, *serial;
-  char extra_info[128];
-  struct block *block;
 
   ASSERT (d->is_ata);
 
@@ -283,32 +350,69 @@ identify_ata_device (struct ata_disk *d)
 
   /* Calculate capacity.
      Read model name and serial number. */
-  capacity = *(uint32_t *) &id[60 * 2];
+  d->capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
-  snprintf (extra_info, sizeof extra_info,
+  snprintf (d->extra_info, sizeof d->extra_info,
             "model \"%s\", serial \"%s\"", model, serial);
 
-  /* Disable access to IDE disks over 1 GB, which are likely
-     physical IDE disks rather than virtual ones.  If we don't
-     allow access to those, we're less likely to scribble on
-     someone's important data.  You can disable this check by
-     hand if you really want to do so. */
-  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
+  if (!too_large (d->capacity))
+    enable_write_cache (d, (const uint16_t *) id);
+}
+
+/* Returns true if a disk of CAPACITY sectors is too large to
+   touch.
+
+   We disable access to IDE disks over 1 GB, which are likely
+   physical IDE disks rather than virtual ones.  If we don't
+   allow access to those, we're less likely to scribble on
+   someone's important data.  You can disable this check by hand
+   if you really want to do so. */
+static bool
+too_large (block_sector_t capacity) 
+{
+  return capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE;
+}
+
+/* Registers identified disk D with the block device layer and
+   scans it for partitions, unless it is too large. */
+static void
+register_ata_device (struct ata_disk *d) 
+{
+  struct block *block;
+
+  if (too_large (d->capacity))
     {
       printf ("%s: ignoring ", d->name);
-      print_human_readable_size (capacity * 512);
+      print_human_readable_size (d->capacity * 512);
       printf ("disk for safety\n");
       d->is_ata = false;
       return;
     }
 
-  /* Register. */
-  block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
+  block = block_register (d->name, BLOCK_RAW, d->extra_info, d->capacity,
                           &ide_operations, d);
   partition_scan (block);
 }
 
+/* Turns on disk D's volatile write cache, given D's IDENTIFY
+   DEVICE data ID, if D has one and supports FLUSH CACHE.  With
+   the cache on, a write completes as soon as the data is in the
+   cache, so the disk may reorder writes and lose them on power
+   failure until ide_flush() is called.  A disk that cannot be
+   flushed is left writing through. */
+static void
+enable_write_cache (struct ata_disk *d, const uint16_t id[])
+{
+  bool words_valid = (id[83] & 0xc000) == 0x4000;
+  bool has_cache = words_valid && (id[82] & (1 << 5)) != 0;
+  bool has_flush = words_valid && (id[83] & (1 << 12)) != 0;
+
+  if (has_cache && has_flush)
+    d->write_cache = issue_nondata_command (d, CMD_SET_FEATURES,
+                                            FEAT_ENABLE_WCACHE);
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,25 +441,89 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.  Each
+   command covers up to MAX_SECTORS_PER_CMD sectors; the disk
+   interrupts once per sector as its data becomes ready.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                   void *buffer)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  uint8_t *p = buffer;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t i;
+
+      select_sector (d, sec_no, n);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+                   sec_no + i);
+          input_sector (c, p);
+          p += BLOCK_SECTOR_SIZE;
+        }
+      sec_no += n;
+      cnt -= n;
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the disk has acknowledged receiving all of the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *buffer)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  const uint8_t *p = buffer;
+
+  lock_acquire (&c->lock);
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t i;
+
+      select_sector (d, sec_no, n);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+                   sec_no + i);
+          output_sector (c, p);
+          sema_down (&c->completion_wait);
+          p += BLOCK_SECTOR_SIZE;
+        }
+      sec_no += n;
+      cnt -= n;
+    }
   lock_release (&c->lock);
 }
 
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read (void *d_, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d_, sec_no, 1, buffer);
+}
+
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
    BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
    acknowledged receiving the data.
@@ -363,37 +531,50 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    per-disk locking is unneeded. */
 static void
 ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+{
+  ide_write_multiple (d_, sec_no, 1, buffer);
+}
+
+/* Waits until the data written to disk D so far is on the
+   medium, by flushing D's write cache if it is enabled.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_flush (void *d_)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+
+  if (!d->write_cache)
+    return;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  if (!issue_nondata_command (d, CMD_FLUSH_CACHE, 0))
+    PANIC ("%s: cache flush failed", d->name);
   lock_release (&c->lock);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    ide_flush
   };
-
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the count CNT of sectors to transfer to the
+   disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (sec_no + cnt <= (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -414,6 +595,23 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
+/* Selects disk D and issues COMMAND, which transfers no data,
+   with FEATURES in the Features register, then waits for the
+   disk to finish it.  Returns true if successful, false if the
+   disk reports an error. */
+static bool
+issue_nondata_command (struct ata_disk *d, uint8_t command, uint8_t features)
+{
+  struct channel *c = d->channel;
+
+  select_device_wait (d);
+  outb (reg_features (c), features);
+  issue_pio_command (c, command);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  return (inb (reg_alt_status (c)) & STA_ERR) == 0;
+}
+
 /* Reads a sector from channel C's data register in PIO mode into
    SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
 static void
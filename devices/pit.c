@@ -14,6 +14,11 @@
 /* PIT cycles per second. */
 #define PIT_HZ 1193180
 
+/* Channel 0's period in PIT cycles, once configured. */
+static unsigned channel0_period;
+
+static unsigned read_channel0 (void);
+
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -80,4 +85,48 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count);
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
+
+  if (channel == 0)
+    channel0_period = count != 0 ? count : 65536;
+}
+
+/* Busy-waits for at least NUM/DENOM seconds by watching channel
+   0's counter count down, which needs no calibration and so
+   works before timer_calibrate() has run, though each poll of
+   the counter takes a few microseconds of port I/O.  Channel 0
+   must already be configured in mode 2.
+
+   Elapsed time is only undercounted, never overcounted, if this
+   thread is preempted for longer than a whole period, so the
+   wait may run long but never short. */
+void
+pit_delay (int64_t num, int32_t denom)
+{
+  int64_t cycles = num * PIT_HZ / denom + 1;
+  unsigned last = read_channel0 ();
+
+  ASSERT (channel0_period != 0);
+  while (cycles > 0)
+    {
+      unsigned now = read_channel0 ();
+      cycles -= (last - now + channel0_period) % channel0_period;
+      last = now;
+    }
+}
+
+/* Latches and returns channel 0's current count. */
+static unsigned
+read_channel0 (void)
+{
+  enum intr_level old_level;
+  unsigned count;
+
+  /* The latch command and both reads must not be split up by
+     another thread doing the same. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0x00);
+  count = inb (PIT_PORT_COUNTER (0));
+  count |= inb (PIT_PORT_COUNTER (0)) << 8;
+  intr_set_level (old_level);
+  return count;
 }
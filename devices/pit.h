@@ -4,5 +4,6 @@
 #include <stdint.h>
 
 void pit_configure_channel (int channel, int mode, int frequency);
+void pit_delay (int64_t num, int32_t denom);
 
 #endif /* devices/pit.h */
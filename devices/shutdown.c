@@ -9,9 +9,14 @@
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
+#ifdef VM
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
+#include "filesys/checksum.h"
+#include "filesys/page-cache.h"
 #endif
 
 /* Keyboard control register port. */
@@ -134,10 +139,15 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  page_cache_print_stats ();
+  checksum_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  swap_print_stats ();
+#endif
 }
@@ -7,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -21,10 +22,21 @@
 static int64_t ticks;
 
 /* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
+   Initialized by timer_calibrate(); until then, brief delays
+   poll the PIT instead. */
 static unsigned loops_per_tick;
 
+/* Time stamp counter cycles per second.
+   Initialized by timer_calibrate(). */
+static uint64_t tsc_hz;
+
+/* Tick count and time stamp counter at the most recent tick
+   boundary seen by wait_for_tick(). */
+static int64_t edge_ticks;
+static uint64_t edge_tsc;
+
 static intr_handler_func timer_interrupt;
+static void wait_for_tick (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -39,31 +51,64 @@ timer_init (void)
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays,
+   and measures the time stamp counter's frequency over the same
+   span of ticks.
+
+   No other thread may be busy meanwhile: time it spends on the
+   CPU during a measurement counts against the loop, making
+   loops_per_tick too low and every later brief delay too short.
+   Delays before calibration poll the PIT instead. */
 void
 timer_calibrate (void) 
 {
-  unsigned high_bit, test_bit;
+  unsigned high_bit, test_bit, loops;
+  int64_t start_ticks;
+  uint64_t start_tsc;
 
   ASSERT (intr_get_level () == INTR_ON);
-  printf ("Calibrating timer...  ");
+
+  wait_for_tick ();
+  start_ticks = edge_ticks;
+  start_tsc = edge_tsc;
 
   /* Approximate loops_per_tick as the largest power-of-two
      still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops (loops_per_tick << 1)) 
+  loops = 1u << 10;
+  while (!too_many_loops (loops << 1)) 
     {
-      loops_per_tick <<= 1;
-      ASSERT (loops_per_tick != 0);
+      loops <<= 1;
+      ASSERT (loops != 0);
     }
 
   /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
+  high_bit = loops;
   for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
     if (!too_many_loops (high_bit | test_bit))
-      loops_per_tick |= test_bit;
+      loops |= test_bit;
+
+  wait_for_tick ();
+  tsc_hz = (edge_tsc - start_tsc) * TIMER_FREQ / (edge_ticks - start_ticks);
+  loops_per_tick = loops;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("Calibrating timer...  %'"PRIu64" loops/s.\n",
+          (uint64_t) loops_per_tick * TIMER_FREQ);
+}
+
+/* Returns the time stamp counter's frequency in Hz, or 0 if
+   timer_calibrate() has not yet measured it. */
+uint64_t
+timer_tsc_hz (void) 
+{
+  return tsc_hz;
+}
+
+/* Converts CYCLES time stamp counter cycles to microseconds.
+   Returns 0 before timer_calibrate() has run. */
+uint64_t
+timer_tsc_to_us (uint64_t cycles) 
+{
+  return tsc_hz >= 1000000 ? cycles / (tsc_hz / 1000000) : 0;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -174,15 +219,27 @@ timer_interrupt (struct intr_frame *args UNUSED)
   thread_tick ();
 }
 
+/* Waits for the next timer tick and records when it came in
+   edge_ticks and edge_tsc. */
+static void
+wait_for_tick (void) 
+{
+  int64_t start = ticks;
+  while (ticks == start)
+    barrier ();
+  edge_tsc = tsc_read ();
+  edge_ticks = ticks;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
 too_many_loops (unsigned loops) 
 {
+  int64_t start;
+
   /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier ();
+  wait_for_tick ();
 
   /* Run LOOPS loops. */
   start = ticks;
@@ -242,5 +299,10 @@ real_time_delay (int64_t num, int32_t denom)
   /* Scale the numerator and denominator down by 1000 to avoid
      the possibility of overflow. */
   ASSERT (denom % 1000 == 0);
+  if (loops_per_tick == 0)
+    {
+      pit_delay (num, denom);
+      return;
+    }
   busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
 }
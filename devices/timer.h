@@ -9,6 +9,8 @@
 
 void timer_init (void);
 void timer_calibrate (void);
+uint64_t timer_tsc_hz (void);
+uint64_t timer_tsc_to_us (uint64_t cycles);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
@@ -1,6 +1,8 @@
-/* cat.c
+/* cp.c
 
-Copies one file to another. */
+Copies one file to another.  The kernel does the copying, and
+shares the data with the original instead of duplicating it
+until either file is written. */
 
 #include <stdio.h>
 #include <syscall.h>
@@ -25,7 +27,7 @@ main (int argc, char *argv[])
     }
 
   /* Create and open output file. */
-  if (!create (argv[2], filesize (in_fd))) 
+  if (!create (argv[2], 0)) 
     {
       printf ("%s: create failed\n", argv[2]);
       return EXIT_FAILURE;
@@ -38,17 +40,11 @@ main (int argc, char *argv[])
     }
 
   /* Copy data. */
-  for (;;) 
+  if (copy_file_range (in_fd, out_fd, filesize (in_fd))
+      != filesize (in_fd)) 
     {
-      char buffer[1024];
-      int bytes_read = read (in_fd, buffer, sizeof buffer);
-      if (bytes_read == 0)
-        break;
-      if (write (out_fd, buffer, bytes_read) != bytes_read) 
-        {
-          printf ("%s: write failed\n", argv[2]);
-          return EXIT_FAILURE;
-        }
+      printf ("%s: write failed\n", argv[2]);
+      return EXIT_FAILURE;
     }
 
   return EXIT_SUCCESS;
@@ -0,0 +1,104 @@
+/* ls.c
+  
+   Lists the contents of the directory or directories named on
+   the command line, or of the current directory if none are
+   named.
+
+   Entries are fetched a buffer at a time with getdents(), which
+   also reports each entry's inumber and type, so listing a large
+   directory takes a handful of system calls instead of one per
+   entry.
+
+   By default, only the name of each file is printed.  If "-l" is
+   given as the first argument, the type, size, and inumber of
+   each file is also printed. */
+
+#include <syscall.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool
+list_dir (const char *dir, bool verbose) 
+{
+  static char buf[1024];
+  int dir_fd = open (dir);
+  int n;
+
+  if (dir_fd == -1) 
+    {
+      printf ("%s: not found\n", dir);
+      return false;
+    }
+  if (!isdir (dir_fd))
+    {
+      printf ("%s: not a directory\n", dir);
+      close (dir_fd);
+      return true;
+    }
+
+  printf ("%s", dir);
+  if (verbose)
+    printf (" (inumber %d)", inumber (dir_fd));
+  printf (":\n");
+
+  while ((n = getdents (dir_fd, buf, sizeof buf)) > 0) 
+    {
+      int ofs;
+
+      for (ofs = 0; ofs < n; ofs += ((struct dirent *) (buf + ofs))->d_reclen)
+        {
+          struct dirent *d = (struct dirent *) (buf + ofs);
+
+          printf ("%s", d->d_name); 
+          if (verbose) 
+            {
+              printf (": ");
+              if (d->d_type == DT_DIR)
+                printf ("directory");
+              else
+                {
+                  char full_name[128];
+                  int entry_fd;
+
+                  snprintf (full_name, sizeof full_name, "%s/%s",
+                            dir, d->d_name);
+                  entry_fd = open (full_name);
+                  if (entry_fd != -1)
+                    printf ("%d-byte file", filesize (entry_fd));
+                  else
+                    printf ("open failed");
+                  close (entry_fd);
+                }
+              printf (", inumber %d", (int) d->d_ino);
+            }
+          printf ("\n");
+        }
+    }
+  close (dir_fd);
+  return n == 0;
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  bool success = true;
+  bool verbose = false;
+  
+  if (argc > 1 && !strcmp (argv[1], "-l")) 
+    {
+      verbose = true;
+      argv++;
+      argc--;
+    }
+  
+  if (argc <= 1)
+    success = list_dir (".", verbose);
+  else 
+    {
+      int i;
+      for (i = 1; i < argc; i++)
+        if (!list_dir (argv[i], verbose))
+          success = false;
+    }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,53 @@
+/* sysbench.c
+
+   Makes many small system calls, for timing with the kernel's
+   syscall-bench action.  Reads FILE 64 bytes at a time with
+   pread(), into a buffer that spans many pages, one page after
+   another, so that the program and the file system both keep
+   touching many pages between and during calls.
+
+   Usage: sysbench FILE [COUNT] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Buffer pages cycled through. */
+#define BUFFER_PAGES 64
+
+/* Bytes read per call. */
+#define CHUNK 64
+
+static char buffer[BUFFER_PAGES][4096];
+
+int
+main (int argc, char *argv[]) 
+{
+  int count = argc > 2 ? atoi (argv[2]) : 100000;
+  unsigned length;
+  int fd, i;
+
+  if (argc < 2)
+    {
+      printf ("usage: sysbench FILE [COUNT]\n");
+      return EXIT_FAILURE;
+    }
+  fd = open (argv[1]);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  length = filesize (fd);
+  if (length < CHUNK)
+    {
+      printf ("%s: shorter than %d bytes\n", argv[1], CHUNK);
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < count; i++)
+    pread (fd, buffer[i % BUFFER_PAGES], CHUNK,
+           (unsigned) i * CHUNK % (length - CHUNK + 1));
+  close (fd);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,379 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/checksum.h"
+#include "filesys/filesys.h"
+#include "filesys/page-cache.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache of file system sectors.
+
+   Reads and writes of inode sectors go through a fixed set of
+   cached sectors; file data is cached a page at a time by the
+   page cache instead (see page-cache.c).  Writes only dirty the
+   cached copy; a background flusher thread writes dirty sectors
+   back once they have been dirty for longer than the flush age,
+   or as soon as more than the dirty ratio of the cache is dirty.
+   It gathers dirty sectors that are adjacent on disk into a
+   single multi-sector request, and also writes back aged file
+   pages under the same rules.  fsync() and sync() write back on
+   demand, and the whole cache is written back at shutdown. */
+
+/* Number of sectors held in the cache. */
+#define CACHE_SIZE 64
+
+/* Most sectors the flusher writes in one request. */
+#define FLUSH_CLUSTER 16
+
+/* Default tunables, overridable from the kernel command line. */
+#define DEFAULT_FLUSH_AGE_MS 3000       /* Write back after 3 s dirty. */
+#define DEFAULT_DIRTY_RATIO 50          /* Or once half the cache is. */
+
+/* A cached sector. */
+struct cache_entry
+  {
+    block_sector_t sector;      /* Sector held, if VALID. */
+    bool valid;                 /* Holds a sector? */
+    bool dirty;                 /* Newer than the copy on disk? */
+    bool accessed;              /* Used since the clock hand passed? */
+    bool busy;                  /* Being written back by the flusher. */
+    int64_t dirty_since;        /* timer_ticks() when it became dirty. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;          /* Protects all of the above. */
+static struct condition busy_done;      /* Signaled when BUSY clears. */
+static size_t clock_hand;               /* Next eviction candidate. */
+static size_t dirty_cnt;                /* Number of dirty entries. */
+
+/* Number of threads waiting to read through the cache.  The
+   flusher backs off while this is nonzero unless the cache is
+   over its dirty ratio, so that background writeback does not
+   queue up in front of interactive reads. */
+static int readers;
+
+/* Tunables. */
+static int flush_age_ms = DEFAULT_FLUSH_AGE_MS;
+static int dirty_ratio = DEFAULT_DIRTY_RATIO;
+
+static thread_func flusher NO_RETURN;
+static struct cache_entry *lookup (block_sector_t);
+static struct cache_entry *get_entry (block_sector_t, bool read);
+static void mark_dirty (struct cache_entry *);
+static void write_back (struct cache_entry *);
+static size_t flush_cluster (struct cache_entry *);
+
+/* Initializes the buffer cache and starts the flusher thread. */
+void
+cache_init (void)
+{
+  lock_init (&cache_lock);
+  cond_init (&busy_done);
+  thread_create ("flusher", PRI_MIN, flusher, NULL);
+}
+
+/* Sets the age, in milliseconds, after which the flusher writes
+   back a dirty sector.  Called while parsing the kernel command
+   line, possibly before cache_init(). */
+void
+cache_set_flush_age (int milliseconds)
+{
+  if (milliseconds > 0)
+    flush_age_ms = milliseconds;
+}
+
+/* Sets the percentage of the cache that may be dirty before the
+   flusher starts writing back sectors regardless of age. */
+void
+cache_set_dirty_ratio (int percent)
+{
+  if (percent > 0 && percent <= 100)
+    dirty_ratio = percent;
+}
+
+/* Reads SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at byte OFS within SECTOR into
+   BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  enum intr_level old_level;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  old_level = intr_disable ();
+  readers++;
+  intr_set_level (old_level);
+
+  lock_acquire (&cache_lock);
+  e = get_entry (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  lock_release (&cache_lock);
+
+  old_level = intr_disable ();
+  readers--;
+  intr_set_level (old_level);
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER to SECTOR. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR starting at byte
+   OFS.  The rest of the sector is read from disk first unless
+   the write covers all of it. */
+void
+cache_write_at (block_sector_t sector, const void *buffer,
+                size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = get_entry (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  mark_dirty (e);
+  lock_release (&cache_lock);
+}
+
+/* Writes back any dirty cached sectors among the CNT sectors
+   starting at SECTOR, and waits for them to reach the disk. */
+void
+cache_flush_range (block_sector_t sector, size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      while (e->busy)
+        cond_wait (&busy_done, &cache_lock);
+      if (e->valid && e->dirty
+          && e->sector >= sector && e->sector - sector < cnt)
+        write_back (e);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes back every dirty cached sector. */
+void
+cache_flush (void)
+{
+  cache_flush_range (0, block_size (fs_device));
+}
+
+/* Drops any cached copies of the CNT sectors starting at SECTOR
+   without writing them back, for a caller that is about to
+   overwrite those sectors on disk directly.  Waits for writes of
+   them already under way, so that none can land afterward. */
+void
+cache_invalidate_range (block_sector_t sector, size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      while (e->busy)
+        cond_wait (&busy_done, &cache_lock);
+      if (e->valid && e->sector >= sector && e->sector - sector < cnt)
+        {
+          if (e->dirty)
+            dirty_cnt--;
+          e->valid = e->dirty = false;
+        }
+    }
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry caching SECTOR, or a null pointer if SECTOR
+   is not cached. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Returns the entry caching SECTOR, loading it into the cache if
+   necessary.  The sector's contents are read from disk on a
+   miss only if READ is true; otherwise the caller must be about
+   to overwrite all of it.  Evicts another sector with the clock
+   algorithm if the cache is full.  The caller must hold
+   cache_lock. */
+static struct cache_entry *
+get_entry (block_sector_t sector, bool read)
+{
+  struct cache_entry *e;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  e = lookup (sector);
+  if (e != NULL)
+    {
+      e->accessed = true;
+      return e;
+    }
+
+  /* Pick a victim, giving recently used entries a second
+     chance.  Entries that the flusher is writing back stay put,
+     so a read can never see a stale copy from disk. */
+  for (;;)
+    {
+      e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+      if (e->busy)
+        continue;
+      if (!e->valid || !e->accessed)
+        break;
+      e->accessed = false;
+    }
+  if (e->valid && e->dirty)
+    write_back (e);
+
+  e->sector = sector;
+  e->valid = true;
+  e->accessed = true;
+  if (read)
+    {
+      block_read (fs_device, sector, e->data);
+      checksum_verify (sector, 1, e->data);
+    }
+  return e;
+}
+
+/* Marks E dirty, noting when it became so. */
+static void
+mark_dirty (struct cache_entry *e)
+{
+  if (!e->dirty)
+    {
+      e->dirty = true;
+      e->dirty_since = timer_ticks ();
+      dirty_cnt++;
+    }
+}
+
+/* Writes E, which must be dirty, back to disk and marks it clean.
+   The caller must hold cache_lock. */
+static void
+write_back (struct cache_entry *e)
+{
+  ASSERT (e->dirty);
+  checksum_update (e->sector, 1, e->data);
+  block_write (fs_device, e->sector, e->data);
+  e->dirty = false;
+  dirty_cnt--;
+}
+
+/* Writes back dirty entry E together with the dirty cached
+   sectors that immediately follow it on disk, in one request of
+   at most FLUSH_CLUSTER sectors.  Drops cache_lock during the
+   write; the entries are marked busy meanwhile so that they are
+   neither evicted nor written back twice.  Returns the number of
+   sectors written. */
+static size_t
+flush_cluster (struct cache_entry *e)
+{
+  static uint8_t buffer[FLUSH_CLUSTER * BLOCK_SECTOR_SIZE];
+  struct cache_entry *run[FLUSH_CLUSTER];
+  block_sector_t first = e->sector;
+  size_t n, i;
+
+  /* Extend the run downward to the first dirty sector in it, then
+     gather it upward. */
+  while (first > 0)
+    {
+      struct cache_entry *prev = lookup (first - 1);
+      if (prev == NULL || !prev->dirty || prev->busy)
+        break;
+      first--;
+    }
+  for (n = 0; n < FLUSH_CLUSTER; n++)
+    {
+      struct cache_entry *next = lookup (first + n);
+      if (next == NULL || !next->dirty || next->busy)
+        break;
+      run[n] = next;
+      memcpy (buffer + n * BLOCK_SECTOR_SIZE, next->data, BLOCK_SECTOR_SIZE);
+      next->dirty = false;
+      next->busy = true;
+      dirty_cnt--;
+    }
+
+  checksum_update (first, n, buffer);
+  lock_release (&cache_lock);
+  block_write_multiple (fs_device, first, n, buffer);
+  lock_acquire (&cache_lock);
+
+  for (i = 0; i < n; i++)
+    run[i]->busy = false;
+  cond_broadcast (&busy_done, &cache_lock);
+  return n;
+}
+
+/* Flusher thread.  Wakes up periodically and writes back sectors
+   that have been dirty for longer than the flush age, oldest
+   first, or every dirty sector while the cache is over its dirty
+   ratio, then does the same for file pages. */
+static void
+flusher (void *aux UNUSED)
+{
+  for (;;)
+    {
+      int64_t age_ticks;
+
+      timer_msleep (flush_age_ms / 4 > 0 ? flush_age_ms / 4 : 1);
+      age_ticks = (int64_t) flush_age_ms * TIMER_FREQ / 1000;
+
+      lock_acquire (&cache_lock);
+      for (;;)
+        {
+          bool pressure = dirty_cnt * 100 > (size_t) dirty_ratio * CACHE_SIZE;
+          struct cache_entry *oldest = NULL;
+          size_t i;
+
+          if (!pressure && readers > 0)
+            break;
+          for (i = 0; i < CACHE_SIZE; i++)
+            {
+              struct cache_entry *e = &cache[i];
+              if (e->valid && e->dirty && !e->busy
+                  && (oldest == NULL || e->dirty_since < oldest->dirty_since))
+                oldest = e;
+            }
+          if (oldest == NULL
+              || (!pressure && timer_elapsed (oldest->dirty_since) < age_ticks))
+            break;
+          flush_cluster (oldest);
+        }
+      lock_release (&cache_lock);
+
+      page_cache_writeback (age_ticks, dirty_ratio);
+    }
+}
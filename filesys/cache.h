@@ -0,0 +1,22 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+void cache_init (void);
+void cache_set_flush_age (int milliseconds);
+void cache_set_dirty_ratio (int percent);
+
+/* Reading and writing through the cache. */
+void cache_read (block_sector_t, void *);
+void cache_read_at (block_sector_t, void *, size_t ofs, size_t size);
+void cache_write (block_sector_t, const void *);
+void cache_write_at (block_sector_t, const void *, size_t ofs, size_t size);
+
+/* Writing back dirty sectors. */
+void cache_flush_range (block_sector_t, size_t cnt);
+void cache_flush (void);
+void cache_invalidate_range (block_sector_t, size_t cnt);
+
+#endif /* filesys/cache.h */
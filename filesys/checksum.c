@@ -0,0 +1,280 @@
+#include "filesys/checksum.h"
+#include <crc32c.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Per-sector checksums.
+
+   The sectors starting at CHECKSUM_SECTOR hold a header and then
+   a CRC-32C of every sector on the file system device, 128 to a
+   sector.  The table is reserved whenever the file system is
+   formatted, but only kept up to date while the kernel runs with
+   -checksum.  Then every sector that is read into the buffer or
+   page cache, or by O_DIRECT, is checked against the table, and
+   the table is updated as sectors are written.  A mismatch is
+   reported on the console and counted; the data is passed up
+   anyway, since there is nothing better to do with it.
+
+   The table is kept in memory and written back only when the file
+   system is shut down, so a crash leaves it out of date.  The
+   header's state records that: the table is rebuilt from the
+   disk contents when it is found in any state but CLEAN.  The
+   sectors of the table itself are not checksummed. */
+
+/* Identifies a checksum table. */
+#define CHECKSUM_MAGIC 0x43524343
+
+/* Checksums per table sector. */
+#define SUMS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (uint32_t))
+
+/* Table states. */
+enum checksum_state
+  {
+    CHECKSUM_CLEAN,             /* Matches the disk. */
+    CHECKSUM_DIRTY,             /* In use; may be out of date. */
+    CHECKSUM_STALE              /* Not maintained; out of date. */
+  };
+
+/* Table header, in sector CHECKSUM_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct checksum_header
+  {
+    uint32_t magic;             /* CHECKSUM_MAGIC. */
+    uint32_t state;             /* A `enum checksum_state'. */
+    uint32_t sector_cnt;        /* Device sectors covered. */
+    uint32_t unused[125];       /* Not used. */
+  };
+
+static bool enabled;            /* -checksum given? */
+static uint32_t *sums;          /* One per device sector, once loaded. */
+static block_sector_t sector_cnt;       /* Number of elements in SUMS. */
+static block_sector_t table_end;        /* First sector past the table. */
+
+/* Statistics. */
+static unsigned long long verify_cnt, mismatch_cnt;
+
+static bool read_header (struct checksum_header *);
+static void write_header (enum checksum_state);
+static void rebuild (void);
+
+/* Turns on checksum maintenance.  Called while parsing the kernel
+   command line. */
+void
+checksum_enable (void)
+{
+  enabled = true;
+}
+
+/* Returns the number of sectors, header included, in the checksum
+   table of a device DEVICE_SECTORS sectors long. */
+size_t
+checksum_table_sectors (block_sector_t device_sectors)
+{
+  return 1 + DIV_ROUND_UP (device_sectors, SUMS_PER_SECTOR);
+}
+
+/* Writes an empty checksum table to a newly formatted file
+   system.  It is filled in by the first checksum_init() with
+   checksums enabled. */
+void
+checksum_format (void)
+{
+  sector_cnt = block_size (fs_device);
+  write_header (CHECKSUM_STALE);
+}
+
+/* Loads the checksum table, or rebuilds it if it is out of date.
+   Without -checksum, only marks the table out of date, since
+   writes from now on will not update it. */
+void
+checksum_init (void)
+{
+  struct checksum_header *h;
+  bool valid;
+
+  sector_cnt = block_size (fs_device);
+  table_end = CHECKSUM_SECTOR + checksum_table_sectors (sector_cnt);
+
+  h = malloc (sizeof *h);
+  if (h == NULL)
+    PANIC ("out of memory reading checksum table");
+  valid = read_header (h);
+  if (!enabled)
+    {
+      if (valid && h->state != CHECKSUM_STALE)
+        {
+          write_header (CHECKSUM_STALE);
+          block_flush (fs_device);
+        }
+      free (h);
+      return;
+    }
+  if (!valid)
+    {
+      printf ("checksum: no checksum table on %s, checksums disabled\n",
+              block_name (fs_device));
+      free (h);
+      return;
+    }
+
+  sums = malloc (sector_cnt * sizeof *sums);
+  if (sums == NULL)
+    {
+      printf ("checksum: no memory for checksum table, checksums disabled\n");
+      free (h);
+      return;
+    }
+  if (h->state == CHECKSUM_CLEAN)
+    {
+      block_sector_t i;
+
+      for (i = 0; i * SUMS_PER_SECTOR < sector_cnt; i++)
+        {
+          block_read (fs_device, CHECKSUM_SECTOR + 1 + i, h);
+          memcpy (sums + i * SUMS_PER_SECTOR, h,
+                  (sector_cnt - i * SUMS_PER_SECTOR < SUMS_PER_SECTOR
+                   ? sector_cnt - i * SUMS_PER_SECTOR : SUMS_PER_SECTOR)
+                  * sizeof *sums);
+        }
+    }
+  else
+    rebuild ();
+  free (h);
+
+  /* Mark the table in use before any writes can outdate it. */
+  write_header (CHECKSUM_DIRTY);
+  block_flush (fs_device);
+}
+
+/* Writes the checksum table back and marks it up to date.  Must
+   be called after everything else has been written back. */
+void
+checksum_done (void)
+{
+  uint32_t *buffer;
+  block_sector_t i;
+
+  if (sums == NULL)
+    return;
+
+  buffer = malloc (BLOCK_SECTOR_SIZE);
+  if (buffer == NULL)
+    PANIC ("out of memory writing checksum table");
+  for (i = 0; i * SUMS_PER_SECTOR < sector_cnt; i++)
+    {
+      size_t n = (sector_cnt - i * SUMS_PER_SECTOR < SUMS_PER_SECTOR
+                  ? sector_cnt - i * SUMS_PER_SECTOR : SUMS_PER_SECTOR);
+      memset (buffer, 0, BLOCK_SECTOR_SIZE);
+      memcpy (buffer, sums + i * SUMS_PER_SECTOR, n * sizeof *sums);
+      block_write (fs_device, CHECKSUM_SECTOR + 1 + i, buffer);
+    }
+  free (buffer);
+
+  /* The table must be on disk before the header vouches for it. */
+  block_flush (fs_device);
+  write_header (CHECKSUM_CLEAN);
+  block_flush (fs_device);
+}
+
+/* Checks the CNT sectors starting at SECTOR, just read from disk
+   into BUFFER, against their checksums.  Returns false, after
+   reporting each bad sector, if any of them do not match. */
+bool
+checksum_verify (block_sector_t sector, size_t cnt, const void *buffer_)
+{
+  const uint8_t *buffer = buffer_;
+  bool ok = true;
+
+  if (sums == NULL)
+    return true;
+  for (; cnt > 0; cnt--, sector++, buffer += BLOCK_SECTOR_SIZE)
+    if (sector >= table_end)
+      {
+        verify_cnt++;
+        if (crc32c (0, buffer, BLOCK_SECTOR_SIZE) != sums[sector])
+          {
+            printf ("checksum: sector %"PRDSNu" of %s is corrupt\n",
+                    sector, block_name (fs_device));
+            mismatch_cnt++;
+            ok = false;
+          }
+      }
+  return ok;
+}
+
+/* Records the checksums of the CNT sectors starting at SECTOR,
+   about to be written to disk from BUFFER. */
+void
+checksum_update (block_sector_t sector, size_t cnt, const void *buffer_)
+{
+  const uint8_t *buffer = buffer_;
+
+  if (sums == NULL)
+    return;
+  for (; cnt > 0; cnt--, sector++, buffer += BLOCK_SECTOR_SIZE)
+    if (sector >= table_end)
+      sums[sector] = crc32c (0, buffer, BLOCK_SECTOR_SIZE);
+}
+
+/* Prints checksum statistics. */
+void
+checksum_print_stats (void)
+{
+  if (sums != NULL)
+    printf ("Checksums: %llu sectors verified, %llu mismatches\n",
+            verify_cnt, mismatch_cnt);
+}
+
+/* Reads the table header into H.  Returns true if it is valid
+   for the file system device. */
+static bool
+read_header (struct checksum_header *h)
+{
+  block_read (fs_device, CHECKSUM_SECTOR, h);
+  return h->magic == CHECKSUM_MAGIC && h->sector_cnt == sector_cnt;
+}
+
+/* Writes a table header in STATE to disk. */
+static void
+write_header (enum checksum_state state)
+{
+  static struct checksum_header h;
+
+  memset (&h, 0, sizeof h);
+  h.magic = CHECKSUM_MAGIC;
+  h.state = state;
+  h.sector_cnt = sector_cnt;
+  block_write (fs_device, CHECKSUM_SECTOR, &h);
+}
+
+/* Recomputes every checksum from the disk contents, a page's
+   worth of sectors at a time. */
+static void
+rebuild (void)
+{
+  uint8_t *buffer = palloc_get_page (PAL_ASSERT);
+  block_sector_t sector;
+
+  printf ("checksum: rebuilding checksum table for %s\n",
+          block_name (fs_device));
+  for (sector = 0; sector < sector_cnt; )
+    {
+      size_t n = sector_cnt - sector < PGSIZE / BLOCK_SECTOR_SIZE
+                 ? sector_cnt - sector : PGSIZE / BLOCK_SECTOR_SIZE;
+      size_t i;
+
+      block_read_multiple (fs_device, sector, n, buffer);
+      for (i = 0; i < n; i++)
+        sums[sector + i] = crc32c (0, buffer + i * BLOCK_SECTOR_SIZE,
+                                   BLOCK_SECTOR_SIZE);
+      sector += n;
+    }
+  palloc_free_page (buffer);
+}
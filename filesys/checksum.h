@@ -0,0 +1,21 @@
+#ifndef FILESYS_CHECKSUM_H
+#define FILESYS_CHECKSUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+void checksum_enable (void);
+size_t checksum_table_sectors (block_sector_t device_sectors);
+void checksum_format (void);
+void checksum_init (void);
+void checksum_done (void);
+
+/* Hooks for code that moves file system sectors to and from the
+   disk. */
+bool checksum_verify (block_sector_t, size_t cnt, const void *);
+void checksum_update (block_sector_t, size_t cnt, const void *);
+
+void checksum_print_stats (void);
+
+#endif /* filesys/checksum.h */
@@ -0,0 +1,173 @@
+#include "filesys/defrag.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "filesys/directory.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/syscall.h"
+
+/* Online defragmenter.
+
+   When enabled with -defrag=SECS, a low-priority kernel thread
+   wakes up every SECS seconds and walks the directory tree from
+   the root.  Each file or directory whose data is split over
+   more than one extent is moved into fewer, longer free runs by
+   inode_defrag(), which also makes the switch to the new
+   location atomic.
+
+   The defragmenter takes the file system lock for one inode at a
+   time and lets go of it in between.  If a system call was
+   waiting for the lock meanwhile, it then sleeps for a while
+   before touching the next inode, so that it only runs while
+   the file system is otherwise idle.
+
+   Each pass that finds fragmented inodes prints the number of
+   extents before and after it. */
+
+/* Deepest directory nesting that a pass descends into. */
+#define DEFRAG_MAX_DEPTH 16
+
+/* How long to back off after making a system call wait. */
+#define DEFRAG_BACKOFF_MS 100
+
+/* Fragmentation totals for a pass. */
+struct defrag_stats
+  {
+    size_t inode_cnt;           /* Inodes examined. */
+    size_t fragmented_cnt;      /* Of those, in more than one extent. */
+    size_t moved_cnt;           /* Of those, moved into fewer extents. */
+    size_t extents_before;      /* Total extents before the pass. */
+    size_t extents_after;       /* Total extents after the pass. */
+  };
+
+/* Seconds between passes, or 0 if the defragmenter is off. */
+static int interval_s;
+
+static thread_func defragger NO_RETURN;
+static void defrag_dir (struct dir *, int depth, struct defrag_stats *);
+static void defrag_inode (struct inode *, struct defrag_stats *);
+static void unlock_fs (void);
+
+/* Starts the defragmenter thread, if it was enabled on the kernel
+   command line. */
+void
+defrag_init (void)
+{
+  if (interval_s > 0)
+    thread_create ("defrag", PRI_MIN, defragger, NULL);
+}
+
+/* Enables the defragmenter, with a pass every SECONDS seconds.
+   Called while parsing the kernel command line. */
+void
+defrag_set_interval (int seconds)
+{
+  if (seconds > 0)
+    interval_s = seconds;
+}
+
+/* Defragmenter thread. */
+static void
+defragger (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct defrag_stats stats = { 0, 0, 0, 0, 0 };
+      struct inode *root;
+      struct dir *dir;
+
+      timer_sleep ((int64_t) interval_s * TIMER_FREQ);
+
+      lock_acquire (&filesys_lock);
+      root = inode_open (ROOT_DIR_SECTOR);
+      defrag_inode (root, &stats);
+      dir = dir_open (root);
+      unlock_fs ();
+
+      if (dir != NULL)
+        defrag_dir (dir, 0, &stats);
+
+      if (stats.fragmented_cnt > 0)
+        printf ("defrag: %zu of %zu inodes fragmented, %zu moved; "
+                "%zu extents before, %zu after\n",
+                stats.fragmented_cnt, stats.inode_cnt, stats.moved_cnt,
+                stats.extents_before, stats.extents_after);
+    }
+}
+
+/* Defragments the entries of DIR, which is DEPTH levels below the
+   root, and the directories below it, then closes DIR.  Must be
+   called without the file system lock held. */
+static void
+defrag_dir (struct dir *dir, int depth, struct defrag_stats *stats)
+{
+  for (;;)
+    {
+      char name[NAME_MAX + 1];
+      block_sector_t inumber;
+      bool is_dir;
+      struct inode *inode;
+      struct dir *subdir = NULL;
+
+      lock_acquire (&filesys_lock);
+      if (!dir_readdir_entry (dir, name, &inumber, &is_dir))
+        {
+          dir_close (dir);
+          unlock_fs ();
+          return;
+        }
+      inode = inode_open (inumber);
+      if (inode != NULL)
+        {
+          defrag_inode (inode, stats);
+          if (is_dir && depth + 1 < DEFRAG_MAX_DEPTH)
+            subdir = dir_open (inode);
+          else
+            inode_close (inode);
+        }
+      unlock_fs ();
+
+      if (subdir != NULL)
+        defrag_dir (subdir, depth + 1, stats);
+    }
+}
+
+/* Defragments INODE and adds it to STATS.  The caller must hold
+   the file system lock. */
+static void
+defrag_inode (struct inode *inode, struct defrag_stats *stats)
+{
+  size_t before;
+
+  if (inode == NULL)
+    return;
+
+  before = inode_extent_cnt (inode);
+  stats->inode_cnt++;
+  stats->extents_before += before;
+  if (before > 1)
+    {
+      stats->fragmented_cnt++;
+      if (inode_defrag (inode))
+        stats->moved_cnt++;
+    }
+  stats->extents_after += inode_extent_cnt (inode);
+}
+
+/* Releases the file system lock.  If a system call was waiting
+   for it, backs off for a while to let the foreground catch up;
+   otherwise just yields. */
+static void
+unlock_fs (void)
+{
+  bool contended = lock_has_waiters (&filesys_lock);
+
+  lock_release (&filesys_lock);
+  if (contended)
+    timer_msleep (DEFRAG_BACKOFF_MS);
+  else
+    thread_yield ();
+}
@@ -0,0 +1,7 @@
+#ifndef FILESYS_DEFRAG_H
+#define FILESYS_DEFRAG_H
+
+void defrag_init (void);
+void defrag_set_interval (int seconds);
+
+#endif /* filesys/defrag.h */
@@ -19,14 +19,29 @@ struct dir_entry
     block_sector_t inode_sector;        /* Sector number of header. */
     char name[NAME_MAX + 1];            /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
+    bool is_dir;                        /* Entry names a directory? */
   };
 
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, with "." and ".." entries that refer to itself
+   and to the directory in PARENT_SECTOR.
+   Returns true if successful, false on failure. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, size_t entry_cnt,
+            block_sector_t parent_sector)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir *dir;
+  bool success;
+
+  if (!inode_create (sector, entry_cnt * sizeof (struct dir_entry), true))
+    return false;
+
+  dir = dir_open (inode_open (sector));
+  success = (dir != NULL
+             && dir_add (dir, ".", sector, true)
+             && dir_add (dir, "..", parent_sector, true));
+  dir_close (dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -134,12 +149,13 @@ dir_lookup (const struct dir *dir, const char *name,
 
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
-   INODE_SECTOR.
+   INODE_SECTOR, and IS_DIR records whether it is a directory.
    Returns true if successful, false on failure.
    Fails if NAME is invalid (i.e. too long) or a disk or memory
    error occurs. */
 bool
-dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
+dir_add (struct dir *dir, const char *name, block_sector_t inode_sector,
+         bool is_dir)
 {
   struct dir_entry e;
   off_t ofs;
@@ -172,6 +188,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
+  e.is_dir = is_dir;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
@@ -201,6 +218,24 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* Only empty directories other than the root may be removed. */
+  if (inode_is_dir (inode))
+    {
+      struct dir *victim;
+      char victim_name[NAME_MAX + 1];
+      bool empty;
+
+      if (e.inode_sector == ROOT_DIR_SECTOR)
+        goto done;
+      victim = dir_open (inode_reopen (inode));
+      if (victim == NULL)
+        goto done;
+      empty = !dir_readdir (victim, victim_name);
+      dir_close (victim);
+      if (!empty)
+        goto done;
+    }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
@@ -220,17 +255,51 @@ dir_remove (struct dir *dir, const char *name)
    contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  return dir_readdir_entry (dir, name, NULL, NULL);
+}
+
+/* Like dir_readdir(), but also stores the entry's inode sector
+   into *INUMBER and whether it is a directory into *IS_DIR, for
+   each of them that is non-null.  The type comes from the
+   directory entry itself, so the entry's inode is not read.
+   The "." and ".." entries are skipped. */
+bool
+dir_readdir_entry (struct dir *dir, char name[NAME_MAX + 1],
+                   block_sector_t *inumber, bool *is_dir)
 {
   struct dir_entry e;
 
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
-      if (e.in_use)
+      if (e.in_use && strcmp (e.name, ".") && strcmp (e.name, ".."))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
+          if (inumber != NULL)
+            *inumber = e.inode_sector;
+          if (is_dir != NULL)
+            *is_dir = e.is_dir;
           return true;
         } 
     }
   return false;
 }
+
+/* Sets the position of the next dir_readdir() in DIR to POS,
+   a value previously returned by dir_tell(). */
+void
+dir_seek (struct dir *dir, off_t pos)
+{
+  ASSERT (dir != NULL);
+  ASSERT (pos >= 0);
+  dir->pos = pos;
+}
+
+/* Returns the position of the next dir_readdir() in DIR. */
+off_t
+dir_tell (const struct dir *dir)
+{
+  ASSERT (dir != NULL);
+  return dir->pos;
+}
@@ -2,6 +2,8 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* An open file. */
 struct file 
@@ -9,6 +11,7 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    bool direct;                /* Bypass the page cache? */
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +26,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->direct = false;
       return file;
     }
   else
@@ -68,7 +72,7 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = file_read_at (file, buffer, size, file->pos);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,20 +85,21 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
+  if (file->direct)
+    return inode_read_direct (file->inode, buffer, size, file_ofs);
   return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written = file_write_at (file, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -102,17 +107,98 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
+  if (file->direct)
+    return inode_write_direct (file->inode, buffer, size, file_ofs);
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Sets whether reads and writes through FILE bypass the page
+   cache, moving whole sectors directly between the caller's
+   buffer and the disk.  Meant for large streaming transfers that
+   would otherwise push everything else out of the cache. */
+void
+file_set_direct (struct file *file, bool direct)
+{
+  ASSERT (file != NULL);
+  file->direct = direct;
+}
+
+/* Reserves disk space for the first LENGTH bytes of FILE without
+   changing its length, so that later writes up to LENGTH fill
+   the reservation instead of allocating.
+   Returns true if successful, false otherwise. */
+bool
+file_reserve (struct file *file, off_t length)
+{
+  ASSERT (file != NULL);
+  return inode_reserve (file->inode, length);
+}
+
+/* Copies up to SIZE bytes from IN, starting at its current
+   position, to OUT at its current position, and advances both
+   positions by the number of bytes copied, which is returned.
+   The copy stops early at the end of IN or if the disk fills up.
+
+   Copying all of IN from its start into an empty OUT shares IN's
+   data sectors with OUT instead of copying them (see
+   inode_reflink()).  Otherwise the data moves a page at a time
+   inside the kernel.  Returns -1 if IN and OUT are the same file
+   or a page cannot be allocated. */
+off_t
+file_copy_range (struct file *in, struct file *out, off_t size)
+{
+  off_t length = inode_length (in->inode);
+  off_t bytes_copied = 0;
+  uint8_t *buffer;
+
+  if (in->inode == out->inode)
+    return -1;
+
+  if (in->pos == 0 && out->pos == 0 && size >= length
+      && inode_reflink (out->inode, in->inode))
+    {
+      in->pos = out->pos = length;
+      return length;
+    }
+
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return -1;
+  while (size > 0)
+    {
+      off_t chunk = size < PGSIZE ? size : PGSIZE;
+      off_t n = inode_read_at (in->inode, buffer, chunk, in->pos);
+
+      if (n == 0)
+        break;
+      n = inode_write_at (out->inode, buffer, n, out->pos);
+      if (n == 0)
+        break;
+      in->pos += n;
+      out->pos += n;
+      bytes_copied += n;
+      size -= n;
+    }
+  palloc_free_page (buffer);
+  return bytes_copied;
+}
+
+/* Writes FILE's data and metadata that are still cached in
+   memory back to disk. */
+void
+file_sync (struct file *file)
+{
+  ASSERT (file != NULL);
+  inode_sync (file->inode);
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
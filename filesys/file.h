@@ -1,6 +1,7 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
@@ -16,6 +17,10 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+void file_set_direct (struct file *, bool);
+bool file_reserve (struct file *, off_t length);
+off_t file_copy_range (struct file *in, struct file *out, off_t size);
+void file_sync (struct file *);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
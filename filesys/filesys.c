@@ -2,15 +2,22 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/checksum.h"
+#include "filesys/defrag.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/page-cache.h"
 #include "filesys/directory.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
 static void do_format (void);
+static struct dir *resolve_parent (struct dir *base, const char *path,
+                                   char name[NAME_MAX + 1]);
+static size_t pick_group (struct dir *parent, bool is_dir);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -22,12 +29,16 @@ filesys_init (bool format)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  page_cache_init ();
+  cache_init ();
   free_map_init ();
 
   if (format) 
     do_format ();
 
   free_map_open ();
+  checksum_init ();
+  defrag_init ();
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -36,6 +47,18 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  filesys_sync ();
+  checksum_done ();
+}
+
+/* Writes all cached file data and metadata back to disk, and
+   waits for it to get out of the disk's write cache. */
+void
+filesys_sync (void)
+{
+  page_cache_flush ();
+  cache_flush ();
+  block_flush (fs_device);
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -45,12 +68,54 @@ filesys_done (void)
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
+  return filesys_create_at (NULL, name, initial_size, false);
+}
+
+/* Opens the file with the given NAME.
+   Returns the new file if successful or a null pointer
+   otherwise.
+   Fails if no file named NAME exists,
+   or if an internal memory allocation fails. */
+struct file *
+filesys_open (const char *name)
+{
+  return filesys_open_at (NULL, name);
+}
+
+/* Deletes the file named NAME.
+   Returns true if successful, false on failure.
+   Fails if no file named NAME exists,
+   or if an internal memory allocation fails. */
+bool
+filesys_remove (const char *name) 
+{
+  return filesys_remove_at (NULL, name);
+}
+
+/* Creates a file or, if IS_DIR is true, a directory at PATH,
+   which is resolved relative to directory BASE unless it is
+   absolute.  A null BASE stands for the root directory.
+   Files are created INITIAL_SIZE bytes long.
+   Returns true if successful, false otherwise.
+   Fails if PATH already exists, if a directory along PATH does
+   not exist or has been removed, or if internal memory
+   allocation fails. */
+bool
+filesys_create_at (struct dir *base, const char *path, off_t initial_size,
+                   bool is_dir)
+{
+  char name[NAME_MAX + 1];
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
+  struct dir *dir = resolve_parent (base, path, name);
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+                  && !inode_is_removed (dir_get_inode (dir))
+                  && free_map_allocate (pick_group (dir, is_dir), 1,
+                                        &inode_sector)
+                  && (is_dir
+                      ? dir_create (inode_sector, 16,
+                                    inode_get_inumber (dir_get_inode (dir)))
+                      : inode_create (inode_sector, initial_size, false))
+                  && dir_add (dir, name, inode_sector, is_dir));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
@@ -58,15 +123,17 @@ filesys_create (const char *name, off_t initial_size)
   return success;
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file or directory at PATH, resolved relative to
+   directory BASE (the root directory if BASE is null) unless it
+   is absolute.  Directories are opened as files whose entries
+   can be read with dir_readdir().
    Returns the new file if successful or a null pointer
-   otherwise.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   otherwise. */
 struct file *
-filesys_open (const char *name)
+filesys_open_at (struct dir *base, const char *path)
 {
-  struct dir *dir = dir_open_root ();
+  char name[NAME_MAX + 1];
+  struct dir *dir = resolve_parent (base, path, name);
   struct inode *inode = NULL;
 
   if (dir != NULL)
@@ -76,28 +143,131 @@ filesys_open (const char *name)
   return file_open (inode);
 }
 
-/* Deletes the file named NAME.
+/* Opens and returns the directory at PATH, resolved as for
+   filesys_open_at().  Returns a null pointer if PATH does not
+   exist or is not a directory. */
+struct dir *
+filesys_open_dir_at (struct dir *base, const char *path)
+{
+  char name[NAME_MAX + 1];
+  struct dir *dir = resolve_parent (base, path, name);
+  struct inode *inode = NULL;
+
+  if (dir != NULL)
+    dir_lookup (dir, name, &inode);
+  dir_close (dir);
+
+  if (inode != NULL && !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return NULL;
+    }
+  return dir_open (inode);
+}
+
+/* Deletes the file or empty directory at PATH, resolved as for
+   filesys_open_at().
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if PATH does not exist, names a non-empty directory or
+   the root directory, or if an internal memory allocation
+   fails. */
 bool
-filesys_remove (const char *name) 
+filesys_remove_at (struct dir *base, const char *path)
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char name[NAME_MAX + 1];
+  struct dir *dir = resolve_parent (base, path, name);
+  bool success = (dir != NULL
+                  && strcmp (name, ".") && strcmp (name, "..")
+                  && dir_remove (dir, name));
   dir_close (dir); 
 
   return success;
 }
-
+
+/* Opens the directory that contains the last component of PATH
+   and copies that component into NAME.  Relative paths start
+   from BASE, or from the root directory if BASE is null, so a
+   caller that holds an open directory skips resolving the
+   prefix that leads to it.  A path with no components, such as
+   "/", yields the starting directory and ".".
+   Returns a null pointer if PATH is empty, if a component is
+   too long, or if a directory along the way does not exist. */
+static struct dir *
+resolve_parent (struct dir *base, const char *path, char name[NAME_MAX + 1])
+{
+  struct dir *dir;
+  const char *p = path;
+
+  if (*path == '\0')
+    return NULL;
+  dir = (*path == '/' || base == NULL) ? dir_open_root () : dir_reopen (base);
+  strlcpy (name, ".", NAME_MAX + 1);
+
+  while (dir != NULL)
+    {
+      struct inode *inode;
+      size_t len;
+
+      /* Find the next component. */
+      while (*p == '/')
+        p++;
+      if (*p == '\0')
+        break;
+      len = strcspn (p, "/");
+      if (len > NAME_MAX)
+        {
+          dir_close (dir);
+          return NULL;
+        }
+      memcpy (name, p, len);
+      name[len] = '\0';
+      p += len;
+
+      /* The last component names the entry within DIR. */
+      while (*p == '/')
+        p++;
+      if (*p == '\0')
+        break;
+
+      /* Otherwise descend into it. */
+      dir_lookup (dir, name, &inode);
+      dir_close (dir);
+      if (inode != NULL && !inode_is_dir (inode))
+        {
+          inode_close (inode);
+          return NULL;
+        }
+      dir = dir_open (inode);
+    }
+  return dir;
+}
+
+/* Returns the block group in which to allocate the inode of a new
+   entry in directory PARENT.  Files go in their parent's group,
+   so that the files of a directory sit close together; new
+   directories go in the emptiest group, which spreads unrelated
+   trees out over the disk. */
+static size_t
+pick_group (struct dir *parent, bool is_dir)
+{
+  if (is_dir)
+    return free_map_emptiest_group ();
+  return free_map_group (inode_get_inumber (dir_get_inode (parent)));
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
+
+  /* Get everything onto the disk before checksum_init() computes
+     the checksum table from it. */
+  filesys_sync ();
+  checksum_format ();
   printf ("done.\n");
 }
@@ -7,14 +7,23 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define CHECKSUM_SECTOR 2       /* First sector of the checksum table. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
 
 void filesys_init (bool format);
 void filesys_done (void);
+void filesys_sync (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
 
+struct dir;
+bool filesys_create_at (struct dir *, const char *path, off_t initial_size,
+                        bool is_dir);
+struct file *filesys_open_at (struct dir *, const char *path);
+struct dir *filesys_open_dir_at (struct dir *, const char *path);
+bool filesys_remove_at (struct dir *, const char *path);
+
 #endif /* filesys/filesys.h */
@@ -1,85 +1,334 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include "filesys/checksum.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+
+/* The disk is divided into block groups of GROUP_SECTORS
+   sectors each (the last group may be shorter), each with its
+   own free bitmap and free count, so that an allocation scans
+   only the groups it tries.  Callers hold the file system lock,
+   which serializes all allocation.
+
+   The first GROUP_INODE_SECTORS sectors of each group are its
+   inode area: free_map_allocate(), which allocates inodes, takes
+   the first free sectors of a group, while data runs from
+   free_map_allocate_run() are carved from the rest of the group
+   first, so that inodes do not break up data runs and a file's
+   data stays near its inode.  The inode area only guides
+   placement; nothing reserves it, so data spills into it once
+   the rest of the group is full, and inodes spill out of it
+   likewise.
+
+   On disk, the free map file at FREE_MAP_SECTOR holds the group
+   bitmaps one after another, one sector per group.  That is
+   byte-for-byte the layout of a single bitmap of the whole disk,
+   but an allocation only writes back its own group's sector. */
+
+/* Sectors per block group: as many as one sector of bitmap
+   covers. */
+#define GROUP_SECTORS (BLOCK_SECTOR_SIZE * 8)
+
+/* Sectors at the start of each group that are preferred for
+   inodes. */
+#define GROUP_INODE_SECTORS 128
+
+/* A block group. */
+struct group
+  {
+    struct bitmap *free_map;    /* One bit per sector, true if in use. */
+    size_t free_cnt;            /* Number of free sectors. */
+  };
 
 static struct file *free_map_file;   /* Free map file. */
-static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct group *groups;         /* Block groups. */
+static size_t group_cnt;             /* Number of block groups. */
+
+static void reserve (block_sector_t sector, size_t cnt);
+static size_t allocate_in_group (size_t group, size_t start, size_t cnt);
+static bool write_group (size_t group);
 
 /* Initializes the free map. */
 void
-free_map_init (void) 
+free_map_init (void)
+{
+  block_sector_t size = block_size (fs_device);
+  size_t i;
+
+  group_cnt = DIV_ROUND_UP (size, GROUP_SECTORS);
+  groups = calloc (group_cnt, sizeof *groups);
+  if (groups == NULL)
+    PANIC ("free map creation failed--file system device is too large");
+  for (i = 0; i < group_cnt; i++)
+    {
+      struct group *g = &groups[i];
+      size_t sectors = (i < group_cnt - 1 ? GROUP_SECTORS
+                        : size - i * GROUP_SECTORS);
+
+      g->free_map = bitmap_create (sectors);
+      if (g->free_map == NULL)
+        PANIC ("bitmap creation failed--file system device is too large");
+      g->free_cnt = sectors;
+    }
+  reserve (FREE_MAP_SECTOR, 1);
+  reserve (ROOT_DIR_SECTOR, 1);
+  reserve (CHECKSUM_SECTOR, checksum_table_sectors (size));
+}
+
+/* Returns the number of block groups. */
+size_t
+free_map_group_cnt (void)
+{
+  return group_cnt;
+}
+
+/* Returns the block group that contains SECTOR. */
+size_t
+free_map_group (block_sector_t sector)
+{
+  return sector / GROUP_SECTORS;
+}
+
+/* Returns the block group with the most free sectors. */
+size_t
+free_map_emptiest_group (void)
 {
-  free_map = bitmap_create (block_size (fs_device));
-  if (free_map == NULL)
-    PANIC ("bitmap creation failed--file system device is too large");
-  bitmap_mark (free_map, FREE_MAP_SECTOR);
-  bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  size_t best = 0;
+  size_t i;
+
+  for (i = 1; i < group_cnt; i++)
+    if (groups[i].free_cnt > groups[best].free_cnt)
+      best = i;
+  return best;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP, taking the first free run in block
+   group GROUP, or failing that in the groups after it.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
-free_map_allocate (size_t cnt, block_sector_t *sectorp)
+free_map_allocate (size_t group, size_t cnt, block_sector_t *sectorp)
+{
+  size_t i;
+
+  for (i = 0; i < group_cnt; i++)
+    {
+      size_t g = (group + i) % group_cnt;
+      size_t ofs = allocate_in_group (g, 0, cnt);
+      if (ofs != BITMAP_ERROR)
+        {
+          *sectorp = g * GROUP_SECTORS + ofs;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Allocates as many free sectors as possible, up to CNT, that
+   immediately follow each other starting at SECTOR, so that an
+   existing run of sectors ending just before SECTOR can be
+   extended in place.  The run stops at the end of SECTOR's block
+   group.  Returns the number of sectors allocated, which is 0 if
+   SECTOR itself is in use or the free_map file could not be
+   written. */
+size_t
+free_map_allocate_at (block_sector_t sector, size_t cnt)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  size_t group = free_map_group (sector);
+  size_t ofs = sector % GROUP_SECTORS;
+  struct group *g;
+  size_t n = 0;
+
+  if (group >= group_cnt)
+    return 0;
+  g = &groups[group];
+
+  while (n < cnt && ofs + n < bitmap_size (g->free_map)
+         && !bitmap_test (g->free_map, ofs + n))
+    n++;
+  if (n > 0)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      bitmap_set_multiple (g->free_map, ofs, n, true);
+      g->free_cnt -= n;
+      if (!write_group (group))
+        {
+          bitmap_set_multiple (g->free_map, ofs, n, false);
+          g->free_cnt += n;
+          n = 0;
+        }
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  return n;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Allocates the longest run of consecutive sectors it can find,
+   up to CNT sectors, and stores the first into *SECTORP.  Looks
+   in block group GROUP first, outside its inode area before
+   inside it, then in the groups after it.
+   Returns the length of the run, or 0 if the disk is full or the
+   free_map file could not be written. */
+size_t
+free_map_allocate_run (size_t group, size_t cnt, block_sector_t *sectorp)
+{
+  if (cnt > GROUP_SECTORS)
+    cnt = GROUP_SECTORS;
+  for (; cnt > 0; cnt /= 2)
+    {
+      size_t i;
+
+      for (i = 0; i < group_cnt; i++)
+        {
+          size_t g = (group + i) % group_cnt;
+          size_t ofs = allocate_in_group (g, GROUP_INODE_SECTORS, cnt);
+          if (ofs == BITMAP_ERROR)
+            ofs = allocate_in_group (g, 0, cnt);
+          if (ofs != BITMAP_ERROR)
+            {
+              *sectorp = g * GROUP_SECTORS + ofs;
+              return cnt;
+            }
+        }
+    }
+  return 0;
+}
+
+/* Makes CNT sectors starting at SECTOR available for use.  The
+   sectors may span block groups. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
-  ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  while (cnt > 0)
+    {
+      size_t group = free_map_group (sector);
+      size_t ofs = sector % GROUP_SECTORS;
+      size_t n = GROUP_SECTORS - ofs < cnt ? GROUP_SECTORS - ofs : cnt;
+      struct group *g = &groups[group];
+
+      ASSERT (bitmap_all (g->free_map, ofs, n));
+      bitmap_set_multiple (g->free_map, ofs, n, false);
+      g->free_cnt += n;
+      write_group (group);
+
+      sector += n;
+      cnt -= n;
+    }
 }
 
 /* Opens the free map file and reads it from disk. */
 void
-free_map_open (void) 
+free_map_open (void)
 {
+  size_t i;
+
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_read (free_map, free_map_file))
-    PANIC ("can't read free map");
+  for (i = 0; i < group_cnt; i++)
+    {
+      struct group *g = &groups[i];
+      if (!bitmap_read_at (g->free_map, free_map_file, i * BLOCK_SECTOR_SIZE))
+        PANIC ("can't read free map");
+      g->free_cnt = bitmap_count (g->free_map, 0, bitmap_size (g->free_map),
+                                  false);
+    }
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
-free_map_close (void) 
+free_map_close (void)
 {
   file_close (free_map_file);
 }
 
+/* Writes the free map back to disk and waits for it to get out
+   of the disk's write cache. */
+void
+free_map_sync (void)
+{
+  if (free_map_file != NULL)
+    file_sync (free_map_file);
+}
+
 /* Creates a new free map file on disk and writes the free map to
    it. */
 void
-free_map_create (void) 
+free_map_create (void)
 {
+  size_t i;
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, group_cnt * BLOCK_SECTOR_SIZE, false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
-    PANIC ("can't write free map");
+  for (i = 0; i < group_cnt; i++)
+    if (!write_group (i))
+      PANIC ("can't write free map");
+}
+
+/* Marks the CNT sectors starting at SECTOR in use, for the file
+   system's fixed structures.  The sectors may span block
+   groups. */
+static void
+reserve (block_sector_t sector, size_t cnt)
+{
+  while (cnt > 0)
+    {
+      struct group *g = &groups[free_map_group (sector)];
+      size_t ofs = sector % GROUP_SECTORS;
+      size_t n = GROUP_SECTORS - ofs < cnt ? GROUP_SECTORS - ofs : cnt;
+
+      bitmap_set_multiple (g->free_map, ofs, n, true);
+      g->free_cnt -= n;
+      sector += n;
+      cnt -= n;
+    }
+}
+
+/* Allocates CNT consecutive free sectors in block group GROUP,
+   taking the first such run at or after sector offset START
+   within the group, and writes the group's bitmap back.  Returns
+   the offset of the first sector within the group, or
+   BITMAP_ERROR if there is no such run or the bitmap could not
+   be written. */
+static size_t
+allocate_in_group (size_t group, size_t start, size_t cnt)
+{
+  struct group *g = &groups[group];
+  size_t ofs = BITMAP_ERROR;
+
+  if (g->free_cnt >= cnt)
+    {
+      ofs = bitmap_scan_and_flip (g->free_map, start, cnt, false);
+      if (ofs != BITMAP_ERROR)
+        {
+          g->free_cnt -= cnt;
+          if (!write_group (group))
+            {
+              bitmap_set_multiple (g->free_map, ofs, cnt, false);
+              g->free_cnt += cnt;
+              ofs = BITMAP_ERROR;
+            }
+        }
+    }
+  return ofs;
+}
+
+/* Writes block group GROUP's bitmap to its sector of the free
+   map file, if the file is open yet.  Returns true if
+   successful. */
+static bool
+write_group (size_t group)
+{
+  return (free_map_file == NULL
+          || bitmap_write_at (groups[group].free_map, free_map_file,
+                              group * BLOCK_SECTOR_SIZE));
 }
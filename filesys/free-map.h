@@ -10,8 +10,15 @@ void free_map_read (void);
 void free_map_create (void);
 void free_map_open (void);
 void free_map_close (void);
+void free_map_sync (void);
 
-bool free_map_allocate (size_t, block_sector_t *);
+size_t free_map_group_cnt (void);
+size_t free_map_group (block_sector_t);
+size_t free_map_emptiest_group (void);
+
+bool free_map_allocate (size_t group, size_t, block_sector_t *);
+size_t free_map_allocate_at (block_sector_t, size_t);
+size_t free_map_allocate_run (size_t group, size_t, block_sector_t *);
 void free_map_release (block_sector_t, size_t);
 
 #endif /* filesys/free-map.h */
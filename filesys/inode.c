@@ -3,24 +3,64 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/checksum.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/page-cache.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of extents that fit in an on-disk inode. */
+#define INODE_EXTENT_CNT 60
+
+/* Writes past the allocated end of a file allocate a multiple of
+   this many sectors, so that a file grown by small appends ends
+   up in a few large extents. */
+#define GROW_SECTORS 8
+
+/* A file's data runs start out in its inode's block group, but
+   each further SPREAD_SECTORS sectors of a large file prefer the
+   next group, so that one big file does not fill up the group
+   that its neighbours' small files live in. */
+#define SPREAD_SECTORS 1024
+
+/* A run of consecutive data sectors. */
+struct extent
+  {
+    block_sector_t start;               /* First sector. */
+    uint32_t count;                     /* Number of sectors. */
+  };
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+   A file's data lives in up to INODE_EXTENT_CNT extents, in file
+   order.  The extents may hold more sectors than LENGTH needs:
+   those are preallocated by inode_reserve() or by growth and are
+   filled in by later writes without calling the allocator.
+
+   Inodes created by inode_reflink() share their extents: such
+   inodes are linked through CLONE_NEXT into a ring, all of whose
+   members have identical extent lists.  The data sectors belong
+   to the ring as a whole and are released only when its last
+   member is.  A member that is about to change its data or
+   extents first leaves the ring with a private copy of the data
+   (see unshare()).  CLONE_NEXT is 0 in an inode that shares
+   nothing; sector 0 holds the free map inode, which is never
+   shared. */
 struct inode_disk
   {
-    off_t length;                           /* File size in bytes. */
-    unsigned magic;                         /* Magic number. */
-    uint32_t unused[125+4-30*4];            /* Not used. */
-    block_sector_t start;                   /* First data sector. */
-    block_sector_t direct_block_array[10];          /* Direct blocks */
-    block_sector_t single_indirect_block_array[10]; /* Indirect block */
-    block_sector_t double_indirect_block_array[10]; /* Doubly indirect blocks */
+    off_t length;                       /* File size in bytes. */
+    unsigned magic;                     /* Magic number. */
+    uint32_t is_dir;                    /* 1 if a directory, else 0. */
+    uint32_t sector_cnt;                /* Data sectors in EXTENTS. */
+    uint32_t extent_cnt;                /* Extents in use. */
+    block_sector_t clone_next;          /* Next inode sharing EXTENTS. */
+    uint32_t unused[2];                 /* Not used. */
+    struct extent extents[INODE_EXTENT_CNT];    /* Data sectors. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -42,18 +82,141 @@ struct inode
     struct inode_disk data;            /* Inode content. */
   };
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
-static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+/* Returns the number of data sectors of DISK_INODE, starting at
+   the IDX'th, that lie consecutively on disk, and stores the
+   first of them in *SECTORP.  Returns 0 if that many sectors are
+   not allocated. */
+static size_t
+index_to_run (const struct inode_disk *disk_inode, size_t idx,
+              block_sector_t *sectorp)
 {
-  ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
-    return -1;
+  size_t i;
+
+  for (i = 0; i < disk_inode->extent_cnt; i++)
+    {
+      const struct extent *e = &disk_inode->extents[i];
+      if (idx < e->count)
+        {
+          *sectorp = e->start + idx;
+          return e->count - idx;
+        }
+      idx -= e->count;
+    }
+  return 0;
+}
+
+/* Stores in MAP where page IDX of DISK_INODE's data lies on
+   disk: the device sectors of as many of its PAGE_SECTORS
+   sectors as are allocated. */
+static void
+page_to_map (const struct inode_disk *disk_inode, size_t idx,
+             struct page_map *map)
+{
+  size_t first = idx * PAGE_SECTORS;
+
+  map->cnt = 0;
+  while (map->cnt < PAGE_SECTORS)
+    {
+      block_sector_t sector;
+      size_t run = index_to_run (disk_inode, first + map->cnt, &sector);
+
+      if (run == 0)
+        break;
+      for (; run > 0 && map->cnt < PAGE_SECTORS; run--)
+        map->sectors[map->cnt++] = sector++;
+    }
+}
+
+/* Releases all but the first KEEP data sectors of DISK_INODE
+   back to the free map. */
+static void
+release_sectors (struct inode_disk *disk_inode, size_t keep)
+{
+  while (disk_inode->sector_cnt > keep)
+    {
+      struct extent *e = &disk_inode->extents[disk_inode->extent_cnt - 1];
+      size_t excess = disk_inode->sector_cnt - keep;
+      size_t n = excess < e->count ? excess : e->count;
+
+      free_map_release (e->start + e->count - n, n);
+      e->count -= n;
+      disk_inode->sector_cnt -= n;
+      if (e->count == 0)
+        disk_inode->extent_cnt--;
+    }
+}
+
+/* Allocates CNT more data sectors at the end of DISK_INODE, whose
+   inode is stored at sector HOME, extending its last extent in
+   place where the following sectors are free and otherwise
+   adding extents made of the longest free runs available, in or
+   after the block group that HOME and the file's size suggest.
+   Returns true if successful.  On failure, nothing is
+   allocated. */
+static bool
+allocate_sectors (struct inode_disk *disk_inode, block_sector_t home,
+                  size_t cnt)
+{
+  size_t old_cnt = disk_inode->sector_cnt;
+
+  while (cnt > 0)
+    {
+      size_t n = 0;
+
+      if (disk_inode->extent_cnt > 0)
+        {
+          struct extent *last;
+
+          last = &disk_inode->extents[disk_inode->extent_cnt - 1];
+          n = free_map_allocate_at (last->start + last->count, cnt);
+          last->count += n;
+        }
+      if (n == 0)
+        {
+          struct extent *e;
+          size_t group;
+
+          if (disk_inode->extent_cnt >= INODE_EXTENT_CNT)
+            break;
+          e = &disk_inode->extents[disk_inode->extent_cnt];
+          group = ((free_map_group (home)
+                    + disk_inode->sector_cnt / SPREAD_SECTORS)
+                   % free_map_group_cnt ());
+          n = free_map_allocate_run (group, cnt, &e->start);
+          if (n == 0)
+            break;
+          e->count = n;
+          disk_inode->extent_cnt++;
+        }
+      disk_inode->sector_cnt += n;
+      cnt -= n;
+    }
+
+  if (cnt > 0)
+    {
+      release_sectors (disk_inode, old_cnt);
+      return false;
+    }
+  return true;
+}
+
+static bool extend_sectors (struct inode *, off_t length);
+static void zero_sectors (const struct inode_disk *);
+static void copy_sectors (const struct inode_disk *dst,
+                          const struct inode_disk *src, uint8_t *buffer);
+static void zero_fill (struct inode *, off_t offset, off_t size);
+static bool begin_write (struct inode *, off_t size, off_t offset);
+static off_t direct_io (struct inode *, uint8_t *, off_t size, off_t offset,
+                        bool write);
+static struct inode *find_open (block_sector_t);
+static bool unshare (struct inode *);
+static void ring_leave (struct inode *);
+
+/* Writes INODE's on-disk data back to its sector. */
+static void
+inode_flush (struct inode *inode)
+{
+  cache_write (inode->sector, &inode->data);
 }
 
 /* List of open inodes, so that opening a single inode twice
@@ -69,11 +232,11 @@ inode_init (void)
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The inode is marked as a directory if IS_DIR is true.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -90,17 +253,11 @@ inode_create (block_sector_t sector, off_t length)
       size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      disk_inode->is_dir = is_dir;
+      if (allocate_sectors (disk_inode, sector, sectors)) 
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          cache_write (sector, disk_inode);
+          zero_sectors (disk_inode);
           success = true; 
         } 
       free (disk_inode);
@@ -114,20 +271,12 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
   struct inode *inode;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  inode = find_open (sector);
+  if (inode != NULL)
+    return inode_reopen (inode);
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
@@ -140,7 +289,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  cache_read (inode->sector, &inode->data);
   return inode;
 }
 
@@ -160,6 +309,14 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns true if INODE is a directory, false if it is an
+   ordinary file. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->data.is_dir != 0;
+}
+
 /* Closes INODE and writes it to disk. (Does it?  Check code.)
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
@@ -176,12 +333,19 @@ inode_close (struct inode *inode)
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
  
-      /* Deallocate blocks if removed. */
+      /* Deallocate blocks if removed.  Data sectors still shared
+         with other inodes stay with them.  Otherwise the file's
+         cached pages stay in the page cache, to be found again
+         if it is reopened. */
       if (inode->removed) 
         {
+          page_cache_invalidate_range (inode, 0, SIZE_MAX);
+          if (inode->data.clone_next != 0)
+            ring_leave (inode);
+          else
+            release_sectors (&inode->data, 0);
+          cache_invalidate_range (inode->sector, 1);
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
         }
 
       free (inode); 
@@ -197,6 +361,13 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Returns true if INODE has been marked for deletion. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -205,119 +376,560 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  struct page_map map;
+
+  ASSERT (offset >= 0);
 
   while (size > 0) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
-      int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      /* File page to read, starting byte offset within page. */
+      size_t page_idx = offset / PGSIZE;
+      int page_ofs = offset % PGSIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
+      /* Bytes left in inode, bytes left in page, lesser of the two. */
       off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+      int page_left = PGSIZE - page_ofs;
+      int min_left = inode_left < page_left ? inode_left : page_left;
 
-      /* Number of bytes to actually copy out of this sector. */
+      /* Number of bytes to actually copy out of this page. */
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      page_to_map (&inode->data, page_idx, &map);
+      page_cache_read (inode, page_idx, &map, buffer + bytes_read,
+                       page_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs.
+   A write past end of file extends the inode, filling any gap
+   between the old end of file and OFFSET with zeros.  Sectors
+   already reserved past the end of file are used first; more
+   are allocated only when those run out. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  struct page_map map;
+
+  ASSERT (offset >= 0);
 
-  if (inode->deny_write_cnt)
+  if (!begin_write (inode, size, offset))
     return 0;
 
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
-      int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      /* File page to write, starting byte offset within page. */
+      size_t page_idx = offset / PGSIZE;
+      int page_ofs = offset % PGSIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
+      /* Bytes left in inode, bytes left in page, lesser of the two. */
       off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+      int page_left = PGSIZE - page_ofs;
+      int min_left = inode_left < page_left ? inode_left : page_left;
 
-      /* Number of bytes to actually write into this sector. */
+      /* Number of bytes to actually write into this page. */
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      page_to_map (&inode->data, page_idx, &map);
+      page_cache_write (inode, page_idx, &map, buffer + bytes_written,
+                        page_ofs, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+
+  return bytes_written;
+}
+
+/* Writes INODE's dirty data pages and its on-disk inode back to
+   disk, and waits for them to get out of the disk's write
+   cache. */
+void
+inode_sync (struct inode *inode)
+{
+  page_cache_flush_range (inode, 0, SIZE_MAX);
+  cache_flush_range (inode->sector, 1);
+  block_flush (fs_device);
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, as inode_read_at() does, but moves whole sectors
+   straight from the disk into BUFFER instead of through the page
+   cache.  Dirty cached pages in the range are written back
+   first.  Any partial sectors at either end still go through the
+   cache. */
+off_t
+inode_read_direct (struct inode *inode, void *buffer, off_t size,
+                   off_t offset)
+{
+  ASSERT (offset >= 0);
+
+  if (offset >= inode->data.length)
+    return 0;
+  if (size > inode->data.length - offset)
+    size = inode->data.length - offset;
+  return direct_io (inode, buffer, size, offset, false);
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   as inode_write_at() does, but moves whole sectors straight
+   from BUFFER to the disk instead of through the page cache.
+   Cached pages in the range are written back and discarded
+   first.  Any partial sectors at either end still go through the
+   cache. */
+off_t
+inode_write_direct (struct inode *inode, const void *buffer, off_t size,
+                    off_t offset)
+{
+  ASSERT (offset >= 0);
+
+  if (!begin_write (inode, size, offset))
+    return 0;
+  return direct_io (inode, (uint8_t *) buffer, size, offset, true);
+}
+
+/* Prepares INODE for a write of SIZE bytes at OFFSET: gives it a
+   private copy of shared data, and extends it if the write ends
+   past end of file, filling any gap between the old end of file
+   and OFFSET with zeros.  Returns false if writes to INODE are
+   denied or the disk is full. */
+static bool
+begin_write (struct inode *inode, off_t size, off_t offset)
+{
+  if (inode->deny_write_cnt || !unshare (inode))
+    return false;
+
+  if (offset + size > inode->data.length)
+    {
+      off_t old_length = inode->data.length;
+
+      if (!extend_sectors (inode, offset + size))
+        return false;
+      inode->data.length = offset + size;
+      inode_flush (inode);
+      if (offset > old_length)
+        zero_fill (inode, old_length, offset - old_length);
+    }
+  return true;
+}
+
+/* Transfers SIZE bytes between BUFFER and INODE at OFFSET, all
+   of which must lie within INODE's length, writing to INODE if
+   WRITE is true and reading from it otherwise.  Runs of whole
+   sectors that are consecutive on disk move in one multi-sector
+   request.  Partial sectors at the ends go through the page
+   cache afterward, so that a page they bring in sees the
+   sectors just written.  Returns the number of bytes
+   transferred. */
+static off_t
+direct_io (struct inode *inode, uint8_t *buffer, off_t size, off_t offset,
+           bool write)
+{
+  off_t head = (BLOCK_SECTOR_SIZE - offset % BLOCK_SECTOR_SIZE)
+               % BLOCK_SECTOR_SIZE;
+  off_t middle, tail, done;
+  size_t first_page, page_cnt;
+
+  if (head > size)
+    head = size;
+  middle = ROUND_DOWN (size - head, BLOCK_SECTOR_SIZE);
+  tail = size - head - middle;
+
+  /* Make the disk current for the pages the middle covers, and
+     drop them if it is about to change underneath them. */
+  first_page = (offset + head) / PGSIZE;
+  page_cnt = DIV_ROUND_UP (offset + head + middle, PGSIZE) - first_page;
+  if (middle > 0)
+    {
+      page_cache_flush_range (inode, first_page, page_cnt);
+      if (write)
+        page_cache_invalidate_range (inode, first_page, page_cnt);
+    }
+
+  for (done = head; done < head + middle; )
+    {
+      block_sector_t sector;
+      size_t whole = (head + middle - done) / BLOCK_SECTOR_SIZE;
+      size_t run = index_to_run (&inode->data,
+                                 (offset + done) / BLOCK_SECTOR_SIZE, &sector);
+
+      ASSERT (run > 0);
+      if (run > whole)
+        run = whole;
+      if (write)
+        {
+          checksum_update (sector, run, buffer + done);
+          block_write_multiple (fs_device, sector, run, buffer + done);
+        }
+      else
+        {
+          block_read_multiple (fs_device, sector, run, buffer + done);
+          checksum_verify (sector, run, buffer + done);
+        }
+      done += run * BLOCK_SECTOR_SIZE;
+    }
+
+  if (write)
+    {
+      inode_write_at (inode, buffer, head, offset);
+      inode_write_at (inode, buffer + head + middle, tail,
+                      offset + head + middle);
+    }
+  else
+    {
+      inode_read_at (inode, buffer, head, offset);
+      inode_read_at (inode, buffer + head + middle, tail,
+                     offset + head + middle);
+    }
+  return size;
+}
+
+/* Makes sure that INODE has data sectors allocated for its
+   first LENGTH bytes, without changing its length or zeroing
+   anything, so that writes up to LENGTH do not need to allocate.
+   The sectors are allocated as contiguously as the free map
+   allows.  Returns true if successful, false if the disk is too
+   full or writes to INODE are denied. */
+bool
+inode_reserve (struct inode *inode, off_t length)
+{
+  size_t sectors = bytes_to_sectors (length);
+
+  if (inode->deny_write_cnt || !unshare (inode))
+    return false;
+  if (sectors <= inode->data.sector_cnt)
+    return true;
+  if (!allocate_sectors (&inode->data, inode->sector,
+                         sectors - inode->data.sector_cnt))
+    return false;
+  inode_flush (inode);
+  return true;
+}
+
+/* Makes DST, which must be empty, a copy of SRC that shares
+   SRC's data sectors instead of copying them, so that the copy
+   costs two inode writes however long SRC is.  Either inode
+   takes a private copy of the data the first time it is written
+   to afterward.  Any sectors reserved in DST are released.
+   Returns true if successful, false if DST is not empty, if
+   either inode is a directory, or if writes to DST are denied. */
+bool
+inode_reflink (struct inode *dst, struct inode *src)
+{
+  if (dst == src || dst->data.length != 0 || dst->deny_write_cnt
+      || dst->data.is_dir || src->data.is_dir)
+    return false;
+
+  /* Give up DST's own sectors. */
+  page_cache_invalidate_range (dst, 0, SIZE_MAX);
+  if (dst->data.clone_next != 0)
+    ring_leave (dst);
+  else
+    release_sectors (&dst->data, 0);
+
+  /* SRC's newest data may be only in its cached pages, and a
+     dirty page written back later would land in the shared
+     sectors, so write them back now. */
+  page_cache_flush_range (src, 0, SIZE_MAX);
+
+  /* Link DST into SRC's ring, making one if SRC had none. */
+  if (src->data.clone_next == 0)
+    src->data.clone_next = src->sector;
+  dst->data.clone_next = src->data.clone_next;
+  src->data.clone_next = dst->sector;
+
+  dst->data.length = src->data.length;
+  dst->data.sector_cnt = src->data.sector_cnt;
+  dst->data.extent_cnt = src->data.extent_cnt;
+  memcpy (dst->data.extents, src->data.extents, sizeof dst->data.extents);
+  inode_flush (src);
+  inode_flush (dst);
+  return true;
+}
+
+/* Moves INODE's data into fewer, longer extents, if the free map
+   has long enough free runs, for the defragmenter.  The data is
+   copied to its new sectors, which the free map on disk then
+   marks in use, the inode is then rewritten to point to them with
+   a single sector write that goes straight to disk, with a disk
+   cache flush before and after, and only then are the old
+   sectors released, with the free map written back again.  After
+   a crash the file therefore reads back entirely from one place
+   or the other, and no sector belongs to two files, although a
+   crash partway through can leak the sectors on the side not in
+   use.  Inodes that share their data with clones, the free map
+   inode, and removed inodes are left alone.
+   Returns true if INODE's data was moved. */
+bool
+inode_defrag (struct inode *inode)
+{
+  struct inode_disk *old, *new;
+  uint8_t *buffer;
+  bool moved = false;
+
+  if (inode->data.extent_cnt < 2 || inode->data.clone_next != 0
+      || inode->sector == FREE_MAP_SECTOR || inode->removed)
+    return false;
+
+  old = malloc (sizeof *old);
+  new = malloc (sizeof *new);
+  buffer = palloc_get_page (0);
+  if (old != NULL && new != NULL && buffer != NULL)
+    {
+      *new = inode->data;
+      new->sector_cnt = 0;
+      new->extent_cnt = 0;
+      if (allocate_sectors (new, inode->sector, inode->data.sector_cnt))
+        {
+          if (new->extent_cnt < inode->data.extent_cnt)
+            {
+              /* Cached pages remember the old sectors, so write
+                 them back before copying and drop them after. */
+              page_cache_flush_range (inode, 0, SIZE_MAX);
+              copy_sectors (new, &inode->data, buffer);
+              page_cache_invalidate_range (inode, 0, SIZE_MAX);
+              free_map_sync ();
+
+              *old = inode->data;
+              inode->data = *new;
+              inode_flush (inode);
+              cache_flush_range (inode->sector, 1);
+              block_flush (fs_device);
+              release_sectors (old, 0);
+              free_map_sync ();
+              moved = true;
+            }
+          else
+            release_sectors (new, 0);
+        }
+    }
+  palloc_free_page (buffer);
+  free (new);
+  free (old);
+  return moved;
+}
+
+/* Returns the number of extents that INODE's data occupies. */
+size_t
+inode_extent_cnt (const struct inode *inode)
+{
+  return inode->data.extent_cnt;
+}
+
+/* Returns the open inode for SECTOR, or a null pointer if that
+   inode is not open. */
+static struct inode *
+find_open (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode;
+    }
+  return NULL;
+}
+
+/* Gives INODE a private copy of its data if it shares its data
+   sectors with other inodes, and takes it out of their ring.
+   Returns true if successful, false if the disk is too full to
+   hold the copy, in which case INODE is unchanged. */
+static bool
+unshare (struct inode *inode)
+{
+  struct inode_disk *old;
+  uint8_t *buffer;
+  bool success = false;
+
+  if (inode->data.clone_next == 0)
+    return true;
+
+  /* None of the ring's pages can be dirty, since
+     inode_reflink() wrote back the source's pages before sharing
+     its sectors and writing to any member since would have
+     unshared it, so the data on disk is current. */
+  old = malloc (sizeof *old);
+  buffer = palloc_get_page (0);
+  if (old != NULL && buffer != NULL)
+    {
+      *old = inode->data;
+      inode->data.sector_cnt = 0;
+      inode->data.extent_cnt = 0;
+      if (allocate_sectors (&inode->data, inode->sector, old->sector_cnt))
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          copy_sectors (&inode->data, old, buffer);
+          ring_leave (inode);
+          success = true;
         }
-      else 
+      else
+        inode->data = *old;
+    }
+  palloc_free_page (buffer);
+  free (old);
+  return success;
+}
+
+/* Takes INODE out of the ring of inodes it shares its data
+   sectors with, leaving the sectors to the rest of the ring.
+   Other members' on-disk inodes are updated through their open
+   copies where there are any, so that a later inode_flush() of
+   one of those does not undo the change. */
+static void
+ring_leave (struct inode *inode)
+{
+  struct inode_disk *disk_inode = NULL;
+  block_sector_t prev_sector = inode->data.clone_next;
+  block_sector_t next_sector = inode->data.clone_next;
+
+  ASSERT (next_sector != 0);
+
+  /* Walk around the ring to the member that points to INODE. */
+  for (;;)
+    {
+      struct inode *prev = find_open (prev_sector);
+      block_sector_t clone_next;
+
+      if (prev != NULL)
+        clone_next = prev->data.clone_next;
+      else
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
+          if (disk_inode == NULL)
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
+              disk_inode = malloc (sizeof *disk_inode);
+              if (disk_inode == NULL)
+                PANIC ("out of memory leaving clone ring");
             }
+          cache_read (prev_sector, disk_inode);
+          clone_next = disk_inode->clone_next;
+        }
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
+      if (clone_next == inode->sector)
+        {
+          /* A ring of one is no ring at all. */
+          clone_next = next_sector != prev_sector ? next_sector : 0;
+          if (prev != NULL)
+            {
+              prev->data.clone_next = clone_next;
+              inode_flush (prev);
+            }
           else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+            {
+              disk_inode->clone_next = clone_next;
+              cache_write (prev_sector, disk_inode);
+            }
+          break;
         }
+      prev_sector = clone_next;
+    }
+  free (disk_inode);
 
-      /* Advance. */
-      size -= chunk_size;
-      offset += chunk_size;
-      bytes_written += chunk_size;
+  inode->data.clone_next = 0;
+  inode_flush (inode);
+}
+
+/* Makes sure INODE has sectors allocated for LENGTH bytes, as
+   for a write that ends at LENGTH.  Rounds the allocation up to
+   a multiple of GROW_SECTORS when the disk has room for it. */
+static bool
+extend_sectors (struct inode *inode, off_t length)
+{
+  size_t sectors = bytes_to_sectors (length);
+  size_t have = inode->data.sector_cnt;
+
+  if (sectors <= have)
+    return true;
+  return (allocate_sectors (&inode->data, inode->sector,
+                            ROUND_UP (sectors - have, GROW_SECTORS))
+          || allocate_sectors (&inode->data, inode->sector, sectors - have));
+}
+
+/* Writes zeros to all of DISK_INODE's data sectors, a page's
+   worth of sectors at a time. */
+static void
+zero_sectors (const struct inode_disk *disk_inode)
+{
+  static const uint8_t zeros[PGSIZE];
+  size_t i;
+
+  for (i = 0; i < disk_inode->extent_cnt; i++)
+    {
+      const struct extent *e = &disk_inode->extents[i];
+      size_t ofs;
+
+      for (ofs = 0; ofs < e->count; ofs += PAGE_SECTORS)
+        {
+          size_t n = e->count - ofs < PAGE_SECTORS ? e->count - ofs
+                                                   : PAGE_SECTORS;
+          checksum_update (e->start + ofs, n, zeros);
+          block_write_multiple (fs_device, e->start + ofs, n, zeros);
+        }
     }
-  free (bounce);
+}
 
-  return bytes_written;
+/* Copies the data sectors of SRC to those of DST, which must
+   have as many, through BUFFER, which must be a page in size.
+   Runs of sectors that are consecutive in both move in one
+   request each way. */
+static void
+copy_sectors (const struct inode_disk *dst, const struct inode_disk *src,
+              uint8_t *buffer)
+{
+  size_t idx = 0;
+
+  ASSERT (dst->sector_cnt == src->sector_cnt);
+
+  while (idx < src->sector_cnt)
+    {
+      block_sector_t from, to;
+      size_t n = index_to_run (src, idx, &from);
+      size_t m = index_to_run (dst, idx, &to);
+
+      if (n > m)
+        n = m;
+      if (n > PAGE_SECTORS)
+        n = PAGE_SECTORS;
+      block_read_multiple (fs_device, from, n, buffer);
+      checksum_verify (from, n, buffer);
+      checksum_update (to, n, buffer);
+      block_write_multiple (fs_device, to, n, buffer);
+      idx += n;
+    }
+}
+
+/* Writes SIZE zero bytes into INODE starting at OFFSET, which
+   must be within INODE's length. */
+static void
+zero_fill (struct inode *inode, off_t offset, off_t size)
+{
+  static const char zeros[BLOCK_SECTOR_SIZE];
+
+  while (size > 0)
+    {
+      off_t chunk = size < BLOCK_SECTOR_SIZE ? size : BLOCK_SECTOR_SIZE;
+      inode_write_at (inode, zeros, chunk, offset);
+      offset += chunk;
+      size -= chunk;
+    }
 }
 
 /* Disables writes to INODE.
@@ -340,6 +952,14 @@ inode_allow_write (struct inode *inode)
   inode->deny_write_cnt--;
 }
 
+/* Returns true if the page of INODE's data containing OFFSET is
+   in the page cache, so that reading it takes no disk I/O. */
+bool
+inode_is_cached (struct inode *inode, off_t offset)
+{
+  return page_cache_contains (inode, offset / PGSIZE);
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -2,22 +2,34 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
 
 void inode_init (void);
-bool inode_create (block_sector_t, off_t);
+bool inode_create (block_sector_t, off_t, bool is_dir);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
+bool inode_is_dir (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+bool inode_is_removed (const struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_read_direct (struct inode *, void *, off_t size, off_t offset);
+off_t inode_write_direct (struct inode *, const void *, off_t size,
+                          off_t offset);
+bool inode_reserve (struct inode *, off_t length);
+bool inode_reflink (struct inode *dst, struct inode *src);
+bool inode_defrag (struct inode *);
+size_t inode_extent_cnt (const struct inode *);
+void inode_sync (struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+bool inode_is_cached (struct inode *, off_t offset);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,376 @@
+#include "filesys/page-cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/checksum.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+
+/* Page cache of file data.
+
+   File contents are cached a page at a time, keyed by the sector
+   of the file's inode and the page index within the file, so
+   that a page is filled from disk
+   and written back to it with at most one multi-sector request
+   per run of consecutive sectors instead of one request per
+   sector.  The buffer cache in cache.c holds only inode sectors.
+
+   Each cached page remembers the sectors it was last filled from
+   or written for (a `struct page_map' supplied by inode.c), so
+   that it can be written back without consulting the inode.
+   Pages therefore outlive the last close of their file, and a
+   file that is opened again finds its data still cached.  Dirty
+   pages are written back on eviction, by fsync() and sync(), and
+   by the flusher thread once they are old enough, following the
+   same rules as dirty sectors.  Pages are dropped only when they
+   are evicted or their file is removed.
+
+   All operations run under a single lock, including the disk
+   I/O, which keeps the cache simple; callers are serialized by
+   the file system lock anyway, so in practice the lock is only
+   contended by the flusher. */
+
+/* Number of pages in the cache. */
+#define PAGE_CACHE_SIZE 64
+
+/* A cached file page. */
+struct page_entry
+  {
+    struct hash_elem elem;      /* Element in `pages', if VALID. */
+    block_sector_t inode;       /* Sector of the file's inode. */
+    size_t idx;                 /* Page index within the file. */
+    bool valid;                 /* Holds a page? */
+    bool dirty;                 /* Newer than the copy on disk? */
+    bool accessed;              /* Used since the clock hand passed? */
+    int64_t dirty_since;        /* timer_ticks() when it became dirty. */
+    struct page_map map;        /* Disk location. */
+    uint8_t *kpage;             /* Page contents. */
+  };
+
+static struct page_entry entries[PAGE_CACHE_SIZE];
+static size_t entry_cnt;                /* Entries with a page. */
+static struct hash pages;               /* Valid entries by key. */
+static struct lock page_cache_lock;     /* Protects all of the above. */
+static size_t clock_hand;               /* Next eviction candidate. */
+static size_t dirty_cnt;                /* Number of dirty pages. */
+
+/* Number of threads waiting to read a page.  As in the buffer
+   cache, aged writeback backs off while this is nonzero. */
+static int readers;
+
+/* Statistics. */
+static unsigned long long hit_cnt, miss_cnt;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static struct page_entry *get_page (struct inode *, size_t idx,
+                                    const struct page_map *, bool fill);
+static void transfer (struct page_entry *, bool write);
+static void write_back (struct page_entry *);
+
+/* Initializes the page cache, allocating its pages from the
+   kernel pool. */
+void
+page_cache_init (void)
+{
+  lock_init (&page_cache_lock);
+  hash_init (&pages, page_hash, page_less, NULL);
+  for (entry_cnt = 0; entry_cnt < PAGE_CACHE_SIZE; entry_cnt++)
+    {
+      entries[entry_cnt].kpage = palloc_get_page (0);
+      if (entries[entry_cnt].kpage == NULL)
+        break;
+    }
+  if (entry_cnt == 0)
+    PANIC ("no memory for page cache");
+}
+
+/* Copies SIZE bytes starting at byte OFS within page IDX of
+   INODE, which is located on disk as described by MAP, into
+   BUFFER.  The page is read from disk if it is not cached. */
+void
+page_cache_read (struct inode *inode, size_t idx, const struct page_map *map,
+                 void *buffer, size_t ofs, size_t size)
+{
+  struct page_entry *e;
+  enum intr_level old_level;
+
+  ASSERT (ofs + size <= PGSIZE);
+
+  old_level = intr_disable ();
+  readers++;
+  intr_set_level (old_level);
+
+  lock_acquire (&page_cache_lock);
+  e = get_page (inode, idx, map, true);
+  memcpy (buffer, e->kpage + ofs, size);
+  lock_release (&page_cache_lock);
+
+  old_level = intr_disable ();
+  readers--;
+  intr_set_level (old_level);
+}
+
+/* Copies SIZE bytes from BUFFER into page IDX of INODE starting
+   at byte OFS and marks the page dirty.  MAP gives the page's
+   location on disk, which must include every sector the write
+   touches.  The rest of the page is read from disk first unless
+   the write covers all of it. */
+void
+page_cache_write (struct inode *inode, size_t idx, const struct page_map *map,
+                  const void *buffer, size_t ofs, size_t size)
+{
+  struct page_entry *e;
+
+  ASSERT (ofs + size <= PGSIZE);
+
+  lock_acquire (&page_cache_lock);
+  e = get_page (inode, idx, map, size < PGSIZE);
+  memcpy (e->kpage + ofs, buffer, size);
+  e->map = *map;
+  if (!e->dirty)
+    {
+      e->dirty = true;
+      e->dirty_since = timer_ticks ();
+      dirty_cnt++;
+    }
+  lock_release (&page_cache_lock);
+}
+
+/* Writes back the dirty cached pages of INODE among the CNT
+   pages starting at page IDX. */
+void
+page_cache_flush_range (struct inode *inode, size_t idx, size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&page_cache_lock);
+  for (i = 0; i < entry_cnt; i++)
+    {
+      struct page_entry *e = &entries[i];
+      if (e->valid && e->dirty && e->inode == inode_get_inumber (inode)
+          && e->idx >= idx && e->idx - idx < cnt)
+        write_back (e);
+    }
+  lock_release (&page_cache_lock);
+}
+
+/* Drops the cached pages of INODE among the CNT pages starting
+   at page IDX, without writing them back. */
+void
+page_cache_invalidate_range (struct inode *inode, size_t idx, size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&page_cache_lock);
+  for (i = 0; i < entry_cnt; i++)
+    {
+      struct page_entry *e = &entries[i];
+      if (e->valid && e->inode == inode_get_inumber (inode)
+          && e->idx >= idx && e->idx - idx < cnt)
+        {
+          if (e->dirty)
+            dirty_cnt--;
+          e->valid = e->dirty = false;
+          hash_delete (&pages, &e->elem);
+        }
+    }
+  lock_release (&page_cache_lock);
+}
+
+/* Writes back every dirty cached page. */
+void
+page_cache_flush (void)
+{
+  size_t i;
+
+  lock_acquire (&page_cache_lock);
+  for (i = 0; i < entry_cnt; i++)
+    if (entries[i].valid && entries[i].dirty)
+      write_back (&entries[i]);
+  lock_release (&page_cache_lock);
+}
+
+/* Writes back, oldest first, pages that have been dirty for at
+   least AGE_TICKS timer ticks, or every dirty page while more
+   than DIRTY_RATIO percent of the cache is dirty.  Stops early
+   if a reader is waiting and the cache is under the ratio.
+   Called periodically by the flusher thread. */
+void
+page_cache_writeback (int64_t age_ticks, int dirty_ratio)
+{
+  lock_acquire (&page_cache_lock);
+  for (;;)
+    {
+      bool pressure = dirty_cnt * 100 > (size_t) dirty_ratio * entry_cnt;
+      struct page_entry *oldest = NULL;
+      size_t i;
+
+      if (!pressure && readers > 0)
+        break;
+      for (i = 0; i < entry_cnt; i++)
+        {
+          struct page_entry *e = &entries[i];
+          if (e->valid && e->dirty
+              && (oldest == NULL || e->dirty_since < oldest->dirty_since))
+            oldest = e;
+        }
+      if (oldest == NULL
+          || (!pressure && timer_elapsed (oldest->dirty_since) < age_ticks))
+        break;
+      write_back (oldest);
+    }
+  lock_release (&page_cache_lock);
+}
+
+/* Returns true if page IDX of INODE is in the cache, so that
+   reading it needs no disk I/O until it is evicted. */
+bool
+page_cache_contains (struct inode *inode, size_t idx)
+{
+  struct page_entry key;
+  bool found;
+
+  key.inode = inode_get_inumber (inode);
+  key.idx = idx;
+  lock_acquire (&page_cache_lock);
+  found = hash_find (&pages, &key.elem) != NULL;
+  lock_release (&page_cache_lock);
+  return found;
+}
+
+/* Prints page cache statistics. */
+void
+page_cache_print_stats (void)
+{
+  size_t resident = hash_size (&pages);
+
+  printf ("Page cache: %llu hits, %llu misses, %zu of %zu pages resident\n",
+          hit_cnt, miss_cnt, resident, entry_cnt);
+}
+
+/* Returns the entry caching page IDX of INODE, loading it into
+   the cache if necessary.  The page is read from the disk
+   location in MAP on a miss only if FILL is true; otherwise the
+   caller must be about to overwrite all of it.  Evicts another
+   page with the clock algorithm if the cache is full.  The
+   caller must hold page_cache_lock. */
+static struct page_entry *
+get_page (struct inode *inode, size_t idx, const struct page_map *map,
+          bool fill)
+{
+  struct page_entry key, *e;
+  struct hash_elem *found;
+
+  ASSERT (lock_held_by_current_thread (&page_cache_lock));
+
+  key.inode = inode_get_inumber (inode);
+  key.idx = idx;
+  found = hash_find (&pages, &key.elem);
+  if (found != NULL)
+    {
+      hit_cnt++;
+      e = hash_entry (found, struct page_entry, elem);
+      e->accessed = true;
+      return e;
+    }
+  miss_cnt++;
+
+  /* Pick a victim, giving recently used pages a second chance. */
+  for (;;)
+    {
+      e = &entries[clock_hand];
+      clock_hand = (clock_hand + 1) % entry_cnt;
+      if (!e->valid || !e->accessed)
+        break;
+      e->accessed = false;
+    }
+  if (e->valid)
+    {
+      if (e->dirty)
+        write_back (e);
+      hash_delete (&pages, &e->elem);
+    }
+
+  e->inode = inode_get_inumber (inode);
+  e->idx = idx;
+  e->valid = true;
+  e->accessed = true;
+  e->map = *map;
+  hash_insert (&pages, &e->elem);
+  if (fill)
+    transfer (e, false);
+  return e;
+}
+
+/* Reads E's page from disk, or writes it to disk if WRITE is
+   true, with one request per run of consecutive sectors in its
+   map.  A read zeros the part of the page past the mapped
+   sectors. */
+static void
+transfer (struct page_entry *e, bool write)
+{
+  const struct page_map *map = &e->map;
+  size_t i = 0;
+
+  while (i < map->cnt)
+    {
+      uint8_t *buffer = e->kpage + i * BLOCK_SECTOR_SIZE;
+      size_t n = 1;
+
+      while (i + n < map->cnt && map->sectors[i + n] == map->sectors[i] + n)
+        n++;
+      if (write)
+        {
+          checksum_update (map->sectors[i], n, buffer);
+          block_write_multiple (fs_device, map->sectors[i], n, buffer);
+        }
+      else
+        {
+          block_read_multiple (fs_device, map->sectors[i], n, buffer);
+          checksum_verify (map->sectors[i], n, buffer);
+        }
+      i += n;
+    }
+  if (!write)
+    memset (e->kpage + map->cnt * BLOCK_SECTOR_SIZE, 0,
+            PGSIZE - map->cnt * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes E, which must be dirty, back to disk and marks it
+   clean. */
+static void
+write_back (struct page_entry *e)
+{
+  ASSERT (e->dirty);
+  transfer (e, true);
+  e->dirty = false;
+  dirty_cnt--;
+}
+
+/* Returns a hash value for page entry E. */
+static unsigned
+page_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct page_entry *e = hash_entry (e_, struct page_entry, elem);
+  return hash_int (e->inode) ^ hash_int (e->idx);
+}
+
+/* Returns true if page entry A precedes page entry B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page_entry *a = hash_entry (a_, struct page_entry, elem);
+  const struct page_entry *b = hash_entry (b_, struct page_entry, elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  return a->idx < b->idx;
+}
@@ -0,0 +1,40 @@
+#ifndef FILESYS_PAGE_CACHE_H
+#define FILESYS_PAGE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+#include "threads/vaddr.h"
+
+struct inode;
+
+/* Sectors in a file page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Where a file page lives on disk: the device sectors holding
+   its first CNT sectors.  Sectors past CNT are not allocated and
+   read as zeros. */
+struct page_map
+  {
+    size_t cnt;
+    block_sector_t sectors[PAGE_SECTORS];
+  };
+
+void page_cache_init (void);
+
+/* Reading and writing through the cache. */
+void page_cache_read (struct inode *, size_t idx, const struct page_map *,
+                      void *, size_t ofs, size_t size);
+void page_cache_write (struct inode *, size_t idx, const struct page_map *,
+                       const void *, size_t ofs, size_t size);
+
+/* Writing back and dropping pages. */
+void page_cache_flush_range (struct inode *, size_t idx, size_t cnt);
+void page_cache_invalidate_range (struct inode *, size_t idx, size_t cnt);
+void page_cache_flush (void);
+void page_cache_writeback (int64_t age_ticks, int dirty_ratio);
+
+bool page_cache_contains (struct inode *, size_t idx);
+void page_cache_print_stats (void);
+
+#endif /* filesys/page-cache.h */
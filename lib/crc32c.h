@@ -0,0 +1,15 @@
+#ifndef __LIB_CRC32C_H
+#define __LIB_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32C (Castagnoli), as used by iSCSI, ext4 and btrfs.
+
+   To checksum a buffer in one go, pass 0 as CRC.  To checksum
+   data that arrives in pieces, pass the result for the previous
+   pieces as CRC for the next. */
+uint32_t crc32c (uint32_t crc, const void *, size_t);
+uint32_t crc32c_bytewise (uint32_t crc, const void *, size_t);
+
+#endif /* lib/crc32c.h */
@@ -0,0 +1,30 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+/* Directory entry records as packed into a user buffer by the
+   getdents system call.  Shared between the kernel, which
+   produces them, and user programs, which walk them. */
+
+#include <stdint.h>
+
+/* Values for d_type. */
+#define DT_REG 1                /* Ordinary file. */
+#define DT_DIR 2                /* Directory. */
+
+/* One directory entry.  Records are variable-length: d_name is
+   null-terminated and the record is padded so that the next one
+   starts on a 4-byte boundary d_reclen bytes later. */
+struct dirent
+  {
+    uint32_t d_ino;             /* Inode number. */
+    uint16_t d_reclen;          /* Length of this record in bytes. */
+    uint8_t d_type;             /* DT_REG or DT_DIR. */
+    uint8_t d_namlen;           /* Length of d_name, excluding null. */
+    char d_name[];              /* Null-terminated file name. */
+  };
+
+/* Size of the record holding a name NAMLEN bytes long. */
+#define DIRENT_RECLEN(NAMLEN) \
+        ((sizeof (struct dirent) + (NAMLEN) + 1 + 3) & ~3u)
+
+#endif /* lib/dirent.h */
@@ -339,24 +339,40 @@ bitmap_file_size (const struct bitmap *b)
    otherwise. */
 bool
 bitmap_read (struct bitmap *b, struct file *file) 
+{
+  return bitmap_read_at (b, file, 0);
+}
+
+/* Writes B to FILE.  Return true if successful, false
+   otherwise. */
+bool
+bitmap_write (const struct bitmap *b, struct file *file)
+{
+  return bitmap_write_at (b, file, 0);
+}
+
+/* Reads B from FILE, starting at byte offset OFS.  Returns true
+   if successful, false otherwise. */
+bool
+bitmap_read_at (struct bitmap *b, struct file *file, off_t ofs) 
 {
   bool success = true;
   if (b->bit_cnt > 0) 
     {
       off_t size = byte_cnt (b->bit_cnt);
-      success = file_read_at (file, b->bits, size, 0) == size;
+      success = file_read_at (file, b->bits, size, ofs) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
     }
   return success;
 }
 
-/* Writes B to FILE.  Return true if successful, false
-   otherwise. */
+/* Writes B to FILE, starting at byte offset OFS.  Return true if
+   successful, false otherwise. */
 bool
-bitmap_write (const struct bitmap *b, struct file *file)
+bitmap_write_at (const struct bitmap *b, struct file *file, off_t ofs)
 {
   off_t size = byte_cnt (b->bit_cnt);
-  return file_write_at (file, b->bits, size, 0) == size;
+  return file_write_at (file, b->bits, size, ofs) == size;
 }
 #endif /* FILESYS */
 
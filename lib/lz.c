@@ -0,0 +1,136 @@
+#include "lz.h"
+#include <debug.h>
+#include <string.h>
+
+/* LZ77 compression in the style of LZRW1 and LZ4: fast rather
+   than tight, for compressing pages on their way to swap.
+
+   The compressed form is a sequence of groups, each a control
+   byte followed by up to 8 items, one per bit of the control
+   byte from least significant to most.  A 0 bit is a literal
+   byte, copied as is.  A 1 bit is a match: two bytes holding a
+   4-bit length code in the top bits of the first and a 12-bit
+   distance back into the output in the rest, followed by a
+   third byte if the length code is 15.  The match is LENGTH +
+   MIN_MATCH bytes long, plus the third byte if present.
+
+   The compressor finds matches through a hash table of the most
+   recent position at which each 3-byte sequence was seen, so it
+   makes a single pass over the input and never searches.  A run
+   of a repeated byte, such as zeros, becomes a chain of matches
+   at distance 1, each covering up to MAX_MATCH bytes. */
+
+#define MIN_MATCH 3                     /* Shortest match encoded. */
+#define MAX_MATCH (MIN_MATCH + 15 + 255) /* Longest match encoded. */
+#define MAX_DISTANCE 4095               /* Farthest match back. */
+#define HASH_BITS 10                    /* log2 (LZ_HASH_SIZE). */
+
+/* Most bytes one group can take: the control byte and 8 matches
+   with length bytes. */
+#define MAX_GROUP (1 + 8 * 3)
+
+/* Returns the hash table index for the 3 bytes at P. */
+static inline unsigned
+hash3 (const uint8_t *p)
+{
+  uint32_t x = p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16);
+  return (x * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Compresses the SIZE bytes at SRC into DST, which has room for
+   MAX bytes, using HASH as scratch space.  Returns the size of
+   the compressed data, or 0 if it would not fit in MAX bytes. */
+size_t
+lz_compress (const void *src_, size_t size, void *dst_, size_t max,
+             uint16_t hash[LZ_HASH_SIZE])
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  size_t in = 0, out = 0;
+
+  ASSERT (size < LZ_MAX_SIZE);
+
+  /* Entries hold a position plus 1, so that 0 means none. */
+  memset (hash, 0, LZ_HASH_SIZE * sizeof *hash);
+  while (in < size)
+    {
+      size_t control;
+      int bit;
+
+      if (out + MAX_GROUP > max)
+        return 0;
+      control = out++;
+      dst[control] = 0;
+      for (bit = 0; bit < 8 && in < size; bit++)
+        {
+          if (in + MIN_MATCH <= size)
+            {
+              unsigned h = hash3 (src + in);
+              size_t candidate = hash[h];
+
+              hash[h] = in + 1;
+              if (candidate != 0 && in - (candidate - 1) <= MAX_DISTANCE
+                  && !memcmp (src + candidate - 1, src + in, MIN_MATCH))
+                {
+                  size_t from = candidate - 1;
+                  size_t distance = in - from;
+                  size_t length = MIN_MATCH;
+                  size_t code;
+
+                  while (in + length < size && length < MAX_MATCH
+                         && src[from + length] == src[in + length])
+                    length++;
+
+                  code = length - MIN_MATCH;
+                  dst[out++] = (code < 15 ? code : 15) << 4 | distance >> 8;
+                  dst[out++] = distance & 0xff;
+                  if (code >= 15)
+                    dst[out++] = code - 15;
+                  dst[control] |= 1 << bit;
+                  in += length;
+                  continue;
+                }
+            }
+          dst[out++] = src[in++];
+        }
+    }
+  return out;
+}
+
+/* Decompresses data compressed by lz_compress() from SRC into
+   DST, which receives SIZE bytes, the size of the original. */
+void
+lz_decompress (const void *src_, void *dst_, size_t size)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  size_t out = 0;
+
+  while (out < size)
+    {
+      uint8_t control = *src++;
+      int bit;
+
+      for (bit = 0; bit < 8 && out < size; bit++)
+        if (control & (1 << bit))
+          {
+            size_t code = src[0] >> 4;
+            size_t distance = (src[0] & 0x0f) << 8 | src[1];
+            size_t length;
+
+            src += 2;
+            if (code == 15)
+              code += *src++;
+            length = code + MIN_MATCH;
+            ASSERT (distance > 0 && distance <= out);
+            ASSERT (length <= size - out);
+
+            /* Copy a byte at a time: a match may overlap its own
+               output, as a run does. */
+            for (; length > 0; length--, out++)
+              dst[out] = dst[out - distance];
+          }
+        else
+          dst[out++] = *src++;
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef __LIB_LZ_H
+#define __LIB_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fast LZ77-style compression of small buffers, such as pages.
+
+   Inputs must be shorter than LZ_MAX_SIZE bytes.  The compressor
+   needs a caller-supplied hash table of LZ_HASH_SIZE entries, so
+   that it uses no static state and little stack. */
+#define LZ_MAX_SIZE 65535
+#define LZ_HASH_SIZE 1024
+
+size_t lz_compress (const void *src, size_t size, void *dst, size_t max,
+                    uint16_t hash[LZ_HASH_SIZE]);
+void lz_decompress (const void *src, void *dst, size_t size);
+
+#endif /* lib/lz.h */
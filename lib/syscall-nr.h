@@ -28,7 +28,29 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_GETDENTS,               /* Reads a batch of directory entries. */
+    SYS_OPENAT,                 /* Opens a file relative to a directory. */
+    SYS_MKDIRAT,                /* Creates a directory relative to one. */
+    SYS_UNLINKAT,               /* Deletes a file relative to a directory. */
+    SYS_FALLOCATE,              /* Reserves disk space for a file. */
+    SYS_FSYNC,                  /* Writes a file's cached data to disk. */
+    SYS_SYNC,                   /* Writes all cached data to disk. */
+    SYS_COPY_FILE_RANGE,        /* Copies data between files. */
+    SYS_PREAD,                  /* Reads from a file at an offset. */
+    SYS_PWRITE,                 /* Writes to a file at an offset. */
+    SYS_READV,                  /* Reads into several buffers. */
+    SYS_WRITEV,                 /* Writes from several buffers. */
+    SYS_OPEN_FLAGS              /* Opens a file with flags. */
   };
 
+/* Directory fd that makes the *at() system calls resolve relative
+   paths against the current directory. */
+#define AT_FDCWD (-100)
+
+/* Flags for open_flags(). */
+#define O_DIRECT 0x1            /* Bypass the file system cache. */
+
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,19 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+/* Scatter/gather buffer descriptors for the readv and writev
+   system calls.  Shared between the kernel and user programs. */
+
+#include <stddef.h>
+
+/* Most buffers that one readv() or writev() call may name. */
+#define IOV_MAX 16
+
+/* One buffer. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Length of buffer in bytes. */
+  };
+
+#endif /* lib/uio.h */
@@ -61,6 +61,25 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; "                   \
+             "pushl %[arg1]; pushl %[arg0]; "                   \
+             "pushl %[number]; int $0x30; addl $20, %%esp"      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
@@ -182,3 +201,81 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+getdents (int fd, void *buffer, unsigned size)
+{
+  return syscall3 (SYS_GETDENTS, fd, buffer, size);
+}
+
+int
+openat (int dirfd, const char *file)
+{
+  return syscall2 (SYS_OPENAT, dirfd, file);
+}
+
+bool
+mkdirat (int dirfd, const char *dir)
+{
+  return syscall2 (SYS_MKDIRAT, dirfd, dir);
+}
+
+bool
+unlinkat (int dirfd, const char *file)
+{
+  return syscall2 (SYS_UNLINKAT, dirfd, file);
+}
+
+bool
+fallocate (int fd, unsigned offset, unsigned length)
+{
+  return syscall3 (SYS_FALLOCATE, fd, offset, length);
+}
+
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+void
+sync (void)
+{
+  syscall0 (SYS_SYNC);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+open_flags (const char *file, int flags)
+{
+  return syscall2 (SYS_OPEN_FLAGS, file, flags);
+}
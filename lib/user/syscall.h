@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <dirent.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +14,13 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Directory fd for the *at() calls that means the current
+   directory. */
+#define AT_FDCWD (-100)
+
+/* Flags for open_flags(). */
+#define O_DIRECT 0x1            /* Bypass the file system cache. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -45,4 +54,19 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int getdents (int fd, void *buffer, unsigned size);
+int openat (int dirfd, const char *file);
+bool mkdirat (int dirfd, const char *dir);
+bool unlinkat (int dirfd, const char *file);
+bool fallocate (int fd, unsigned offset, unsigned length);
+bool fsync (int fd);
+void sync (void);
+int copy_file_range (int fd_in, int fd_out, unsigned size);
+int pread (int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int open_flags (const char *file, int flags);
+
 #endif /* lib/user/syscall.h */
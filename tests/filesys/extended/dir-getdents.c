@@ -0,0 +1,64 @@
+/* Creates several files in the root directory, then reads the
+   root directory back with getdents() through a buffer that
+   only holds a couple of entries at a time, checking that every
+   file appears exactly once with the right type and inumber. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char *names[] = {"alpha", "beta", "gamma"};
+#define NAME_CNT (sizeof names / sizeof *names)
+
+void
+test_main (void) 
+{
+  int found[NAME_CNT];
+  char buf[40];
+  size_t i;
+  int fd;
+  int n;
+
+  for (i = 0; i < NAME_CNT; i++)
+    {
+      CHECK (create (names[i], 0), "create \"%s\"", names[i]);
+      found[i] = 0;
+    }
+
+  CHECK ((fd = open ("/")) > 1, "open \"/\"");
+  CHECK (isdir (fd), "isdir \"/\"");
+
+  msg ("getdents \"/\"");
+  while ((n = getdents (fd, buf, sizeof buf)) > 0)
+    {
+      int ofs;
+
+      for (ofs = 0; ofs < n; ofs += ((struct dirent *) (buf + ofs))->d_reclen)
+        {
+          struct dirent *d = (struct dirent *) (buf + ofs);
+
+          for (i = 0; i < NAME_CNT; i++)
+            if (!strcmp (d->d_name, names[i]))
+              {
+                int file_fd = open (names[i]);
+                if (file_fd < 2)
+                  fail ("open \"%s\" failed", names[i]);
+                if (d->d_type != DT_REG)
+                  fail ("\"%s\" has type %d", names[i], d->d_type);
+                if ((int) d->d_ino != inumber (file_fd))
+                  fail ("\"%s\" has wrong inumber", names[i]);
+                close (file_fd);
+                found[i]++;
+              }
+        }
+    }
+  CHECK (n == 0, "getdents at end of directory returns 0");
+
+  for (i = 0; i < NAME_CNT; i++)
+    if (found[i] != 1)
+      fail ("\"%s\" listed %d times", names[i], found[i]);
+
+  CHECK (getdents (fd, buf, 4) == 0, "getdents after end returns 0");
+  close (fd);
+}
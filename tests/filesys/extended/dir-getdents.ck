@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) create "alpha"
+(dir-getdents) create "beta"
+(dir-getdents) create "gamma"
+(dir-getdents) open "/"
+(dir-getdents) isdir "/"
+(dir-getdents) getdents "/"
+(dir-getdents) getdents at end of directory returns 0
+(dir-getdents) getdents after end returns 0
+(dir-getdents) end
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Holds a directory open and creates, opens, and deletes
+   entries relative to it with the *at() system calls. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int dir_fd;
+  int fd;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  CHECK (mkdirat (dir_fd, "sub"), "mkdirat \"sub\"");
+  CHECK (create ("d/sub/f", 100), "create \"d/sub/f\"");
+
+  CHECK ((fd = openat (dir_fd, "sub/f")) > 1, "openat \"sub/f\"");
+  CHECK (filesize (fd) == 100, "filesize \"sub/f\"");
+  close (fd);
+
+  CHECK ((fd = openat (dir_fd, "sub")) > 1, "openat \"sub\"");
+  CHECK (isdir (fd), "isdir \"sub\"");
+  CHECK (!unlinkat (dir_fd, "sub"), "unlinkat non-empty \"sub\" (must fail)");
+  CHECK (unlinkat (fd, "f"), "unlinkat \"f\"");
+  CHECK (openat (fd, "f") == -1, "openat \"f\" (must fail)");
+  close (fd);
+
+  CHECK (unlinkat (dir_fd, "sub"), "unlinkat \"sub\"");
+  CHECK (openat (AT_FDCWD, "d/sub") == -1, "openat \"d/sub\" (must fail)");
+  CHECK (openat (dir_fd, "/d") > 1, "openat absolute \"/d\"");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-openat) begin
+(dir-openat) mkdir "d"
+(dir-openat) open "d"
+(dir-openat) mkdirat "sub"
+(dir-openat) create "d/sub/f"
+(dir-openat) openat "sub/f"
+(dir-openat) filesize "sub/f"
+(dir-openat) openat "sub"
+(dir-openat) isdir "sub"
+(dir-openat) unlinkat non-empty "sub" (must fail)
+(dir-openat) unlinkat "f"
+(dir-openat) openat "f" (must fail)
+(dir-openat) unlinkat "sub"
+(dir-openat) openat "d/sub" (must fail)
+(dir-openat) openat absolute "/d"
+(dir-openat) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"a" => ["a" x 9000],
+		"b" => ["a" x 4000 . "b" x 100 . "a" x 4900],
+		"c" => ["c" x 4000 . "b" x 100]});
+pass;
@@ -0,0 +1,75 @@
+/* Copies a file with copy_file_range(), which shares its data
+   with the original, then writes into the copy and checks that
+   the original is unchanged.  Also copies part of the original
+   into a file that already has data, which copies the bytes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 9000
+#define PATCH_OFS 4000
+#define PATCH_SIZE 100
+
+static char buf[FILE_SIZE];
+
+/* Checks that FILE_NAME, open as FD, holds SIZE bytes, each of
+   which is PATCH within the patch and FILL elsewhere. */
+static void
+check_data (int fd, const char *file_name, int size, char fill, char patch)
+{
+  int i;
+
+  seek (fd, 0);
+  if (read (fd, buf, size) != size)
+    fail ("read \"%s\" failed", file_name);
+  for (i = 0; i < size; i++)
+    {
+      char expect = (i >= PATCH_OFS && i < PATCH_OFS + PATCH_SIZE
+                     ? patch : fill);
+      if (buf[i] != expect)
+        fail ("byte %d of \"%s\" is %02hhx, expected %02hhx",
+              i, file_name, buf[i], expect);
+    }
+}
+
+void
+test_main (void) 
+{
+  int a, b, c;
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK ((a = open ("a")) > 1, "open \"a\"");
+  memset (buf, 'a', FILE_SIZE);
+  CHECK (write (a, buf, FILE_SIZE) == FILE_SIZE, "write \"a\"");
+
+  CHECK (create ("b", 0), "create \"b\"");
+  CHECK ((b = open ("b")) > 1, "open \"b\"");
+  seek (a, 0);
+  CHECK (copy_file_range (a, b, FILE_SIZE) == FILE_SIZE,
+         "copy \"a\" to \"b\"");
+  CHECK (filesize (b) == FILE_SIZE, "filesize \"b\" is %d", FILE_SIZE);
+  CHECK (tell (a) == FILE_SIZE && tell (b) == FILE_SIZE,
+         "positions advanced");
+
+  memset (buf, 'b', PATCH_SIZE);
+  seek (b, PATCH_OFS);
+  CHECK (write (b, buf, PATCH_SIZE) == PATCH_SIZE, "patch \"b\"");
+  msg ("check \"a\"");
+  check_data (a, "a", FILE_SIZE, 'a', 'a');
+  msg ("check \"b\"");
+  check_data (b, "b", FILE_SIZE, 'a', 'b');
+
+  CHECK (create ("c", 0), "create \"c\"");
+  CHECK ((c = open ("c")) > 1, "open \"c\"");
+  memset (buf, 'c', PATCH_OFS);
+  CHECK (write (c, buf, PATCH_OFS) == PATCH_OFS, "write \"c\"");
+  seek (b, PATCH_OFS);
+  CHECK (copy_file_range (b, c, PATCH_SIZE) == PATCH_SIZE,
+         "copy part of \"b\" to \"c\"");
+  msg ("check \"c\"");
+  check_data (c, "c", PATCH_OFS + PATCH_SIZE, 'c', 'b');
+
+  CHECK (copy_file_range (a, a, 1) == -1, "copy \"a\" to itself fails");
+}
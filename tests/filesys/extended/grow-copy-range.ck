@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-copy-range) begin
+(grow-copy-range) create "a"
+(grow-copy-range) open "a"
+(grow-copy-range) write "a"
+(grow-copy-range) create "b"
+(grow-copy-range) open "b"
+(grow-copy-range) copy "a" to "b"
+(grow-copy-range) filesize "b" is 9000
+(grow-copy-range) positions advanced
+(grow-copy-range) patch "b"
+(grow-copy-range) check "a"
+(grow-copy-range) check "b"
+(grow-copy-range) create "c"
+(grow-copy-range) open "c"
+(grow-copy-range) write "c"
+(grow-copy-range) copy part of "b" to "c"
+(grow-copy-range) check "c"
+(grow-copy-range) copy "a" to itself fails
+(grow-copy-range) end
+EOF
+pass;
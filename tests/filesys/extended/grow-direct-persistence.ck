@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"big" => ["\0" x 100 . "d" x 924 . "y" x 512 . "d" x 512
+			  . "x" x 10 . "d" x 6042]});
+pass;
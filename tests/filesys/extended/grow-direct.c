@@ -0,0 +1,57 @@
+/* Writes and reads a file opened with O_DIRECT, including
+   partial sectors at both ends, and checks that direct and
+   cached access through another fd see each other's writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 8100
+#define START 100
+
+static char buf[FILE_SIZE];
+static char expect[FILE_SIZE];
+
+/* Reads all of the file through FD and compares it against
+   EXPECT. */
+static void
+check (int fd, const char *how)
+{
+  int i;
+
+  if (pread (fd, buf, FILE_SIZE, 0) != FILE_SIZE)
+    fail ("%s read failed", how);
+  for (i = 0; i < FILE_SIZE; i++)
+    if (buf[i] != expect[i])
+      fail ("%s read: byte %d is %02hhx, expected %02hhx",
+            how, i, buf[i], expect[i]);
+  msg ("%s read matches", how);
+}
+
+void
+test_main (void) 
+{
+  int direct, cached;
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((direct = open_flags ("big", O_DIRECT)) > 1,
+         "open \"big\" with O_DIRECT");
+  CHECK ((cached = open ("big")) > 1, "open \"big\"");
+  CHECK (open_flags ("big", 0x80) == -1, "open with bad flags fails");
+
+  memset (buf, 'd', FILE_SIZE - START);
+  seek (direct, START);
+  CHECK (write (direct, buf, FILE_SIZE - START) == FILE_SIZE - START,
+         "direct write");
+  memset (expect + START, 'd', FILE_SIZE - START);
+
+  CHECK (pwrite (cached, "xxxxxxxxxx", 10, 2048) == 10, "cached write");
+  memset (expect + 2048, 'x', 10);
+  check (direct, "direct");
+
+  memset (buf, 'y', 512);
+  CHECK (pwrite (direct, buf, 512, 1024) == 512, "direct write of a sector");
+  memset (expect + 1024, 'y', 512);
+  check (cached, "cached");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-direct) begin
+(grow-direct) create "big"
+(grow-direct) open "big" with O_DIRECT
+(grow-direct) open "big"
+(grow-direct) open with bad flags fails
+(grow-direct) direct write
+(grow-direct) cached write
+(grow-direct) direct read matches
+(grow-direct) direct write of a sector
+(grow-direct) cached read matches
+(grow-direct) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Reserves space for a file with fallocate(), checks that its
+   length does not change, then appends into the reservation and
+   reads the data back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 20000
+#define CHUNK_SIZE 1000
+
+static char buf[CHUNK_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+  int ofs;
+
+  CHECK (create ("log", 0), "create \"log\"");
+  CHECK ((fd = open ("log")) > 1, "open \"log\"");
+  CHECK (fallocate (fd, 0, FILE_SIZE), "fallocate \"log\"");
+  CHECK (filesize (fd) == 0, "filesize \"log\" is still 0");
+
+  memset (buf, 'a', sizeof buf);
+  msg ("append to \"log\"");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    if (write (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+      fail ("write %d bytes at offset %d failed", CHUNK_SIZE, ofs);
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"log\" is %d", FILE_SIZE);
+
+  msg ("read \"log\"");
+  seek (fd, 0);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    {
+      int i;
+
+      if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("read %d bytes at offset %d failed", CHUNK_SIZE, ofs);
+      for (i = 0; i < CHUNK_SIZE; i++)
+        if (buf[i] != 'a')
+          fail ("byte %d differs", ofs + i);
+    }
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fallocate) begin
+(grow-fallocate) create "log"
+(grow-fallocate) open "log"
+(grow-fallocate) fallocate "log"
+(grow-fallocate) filesize "log" is still 0
+(grow-fallocate) append to "log"
+(grow-fallocate) filesize "log" is 20000
+(grow-fallocate) read "log"
+(grow-fallocate) end
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Grows a file, calling fsync() after every chunk, then sync()s
+   the whole file system and reads the data back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 12000
+#define CHUNK_SIZE 1500
+
+static char buf[CHUNK_SIZE];
+
+void
+test_main (void) 
+{
+  int fd;
+  int ofs;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+
+  memset (buf, 'f', sizeof buf);
+  msg ("write and fsync \"data\"");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    {
+      if (write (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("write %d bytes at offset %d failed", CHUNK_SIZE, ofs);
+      if (!fsync (fd))
+        fail ("fsync after offset %d failed", ofs);
+    }
+  CHECK (!fsync (fd + 1), "fsync unopened fd fails");
+
+  msg ("sync");
+  sync ();
+
+  msg ("read \"data\"");
+  seek (fd, 0);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_SIZE)
+    {
+      int i;
+
+      if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("read %d bytes at offset %d failed", CHUNK_SIZE, ofs);
+      for (i = 0; i < CHUNK_SIZE; i++)
+        if (buf[i] != 'f')
+          fail ("byte %d differs", ofs + i);
+    }
+  close (fd);
+}
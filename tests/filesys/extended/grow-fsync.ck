@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fsync) begin
+(grow-fsync) create "data"
+(grow-fsync) open "data"
+(grow-fsync) write and fsync "data"
+(grow-fsync) fsync unopened fd fails
+(grow-fsync) sync
+(grow-fsync) read "data"
+(grow-fsync) end
+EOF
+pass;
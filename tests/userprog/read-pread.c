@@ -0,0 +1,42 @@
+/* Reads pieces of a file with pread() and readv(), checking that
+   pread() leaves the file position alone and that readv() fills
+   its buffers in order. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char head[10], tail[20], rest[sizeof sample];
+  struct iovec iov[3];
+  int handle, byte_cnt;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  byte_cnt = pread (handle, tail, sizeof tail, 50);
+  if (byte_cnt != sizeof tail)
+    fail ("pread() returned %d instead of %zu", byte_cnt, sizeof tail);
+  if (memcmp (tail, sample + 50, sizeof tail))
+    fail ("pread() at offset 50 read wrong data");
+  CHECK (tell (handle) == 0, "pread() leaves position at 0");
+
+  iov[0].iov_base = head;
+  iov[0].iov_len = sizeof head;
+  iov[1].iov_base = tail;
+  iov[1].iov_len = sizeof tail;
+  iov[2].iov_base = rest;
+  iov[2].iov_len = sizeof rest;
+  byte_cnt = readv (handle, iov, 3);
+  if (byte_cnt != sizeof sample - 1)
+    fail ("readv() returned %d instead of %zu", byte_cnt, sizeof sample - 1);
+  if (memcmp (head, sample, sizeof head)
+      || memcmp (tail, sample + sizeof head, sizeof tail)
+      || memcmp (rest, sample + sizeof head + sizeof tail,
+                 sizeof sample - 1 - sizeof head - sizeof tail))
+    fail ("readv() read wrong data");
+  CHECK (tell (handle) == sizeof sample - 1, "readv() advances position");
+}
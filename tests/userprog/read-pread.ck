@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(read-pread) begin
+(read-pread) open "sample.txt"
+(read-pread) pread() leaves position at 0
+(read-pread) readv() advances position
+(read-pread) end
+read-pread: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Passes pwrite() and pread() offsets that a file offset cannot
+   represent, which must fail with -1 without touching the
+   file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (pwrite (handle, buf, 100, 0xffffff9c) == -1,
+         "pwrite() at offset 0xffffff9c fails");
+  CHECK (pwrite (handle, buf, 2, 0x7fffffff) == -1,
+         "pwrite() past offset 0x7fffffff fails");
+  CHECK (pread (handle, buf, 100, 0xffffff9c) == -1,
+         "pread() at offset 0xffffff9c fails");
+  CHECK (pread (handle, buf, 2, 0x7fffffff) == -1,
+         "pread() past offset 0x7fffffff fails");
+
+  CHECK (read (handle, buf, sizeof sample - 1) == sizeof sample - 1,
+         "read \"sample.txt\"");
+  if (memcmp (buf, sample, sizeof sample - 1))
+    fail ("\"sample.txt\" was changed");
+}
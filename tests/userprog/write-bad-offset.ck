@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(write-bad-offset) begin
+(write-bad-offset) open "sample.txt"
+(write-bad-offset) pwrite() at offset 0xffffff9c fails
+(write-bad-offset) pwrite() past offset 0x7fffffff fails
+(write-bad-offset) pread() at offset 0xffffff9c fails
+(write-bad-offset) pread() past offset 0x7fffffff fails
+(write-bad-offset) read "sample.txt"
+(write-bad-offset) end
+write-bad-offset: exit(0)
+EOF
+pass;
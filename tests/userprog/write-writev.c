@@ -0,0 +1,40 @@
+/* Writes a file from scattered buffers with writev(), patches
+   it with pwrite(), and reads it back to check both. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  struct iovec iov[3];
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 7;
+  iov[1].iov_base = sample + 7;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 7;
+  iov[2].iov_len = size - 7;
+  byte_cnt = writev (handle, iov, 3);
+  if (byte_cnt != (int) size)
+    fail ("writev() returned %d instead of %zu", byte_cnt, size);
+
+  byte_cnt = pwrite (handle, "AMAZING", 7, 1);
+  if (byte_cnt != 7)
+    fail ("pwrite() returned %d instead of 7", byte_cnt);
+  CHECK (tell (handle) == size, "pwrite() leaves position at end");
+
+  memcpy (sample + 1, "AMAZING", 7);
+  if (pread (handle, buf, size, 0) != (int) size || memcmp (buf, sample, size))
+    fail ("file contents differ");
+  msg ("verified contents of \"test.txt\"");
+}
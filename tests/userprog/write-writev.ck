@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(write-writev) begin
+(write-writev) create "test.txt"
+(write-writev) open "test.txt"
+(write-writev) pwrite() leaves position at end
+(write-writev) verified contents of "test.txt"
+(write-writev) end
+write-writev: exit(0)
+EOF
+pass;
@@ -0,0 +1,39 @@
+/* Stores into a file through a mapping and checks that read()
+   sees the stores while the mapping is still in place, then
+   write()s to the file and checks that the mapping shows the
+   new data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  static const char stored[] = "stored through the mapping";
+  static const char written[] = "written with write()";
+  char buf[sizeof stored];
+  int handle;
+  mapid_t map;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+
+  memcpy (ACTUAL, stored, sizeof stored);
+  CHECK (read (handle, buf, sizeof stored) == sizeof stored,
+         "read \"sample.txt\"");
+  CHECK (!memcmp (buf, stored, sizeof stored),
+         "read() sees stores through the mapping");
+
+  seek (handle, 512);
+  CHECK (write (handle, written, sizeof written) == sizeof written,
+         "write \"sample.txt\"");
+  CHECK (!memcmp ((char *) ACTUAL + 512, written, sizeof written),
+         "mapping sees data from write()");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-coherent) begin
+(mmap-coherent) open "sample.txt"
+(mmap-coherent) mmap "sample.txt"
+(mmap-coherent) read "sample.txt"
+(mmap-coherent) read() sees stores through the mapping
+(mmap-coherent) write "sample.txt"
+(mmap-coherent) mapping sees data from write()
+(mmap-coherent) end
+EOF
+pass;
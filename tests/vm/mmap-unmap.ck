@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::vm::process_death;
+
+check_process_death ('mmap-unmap');
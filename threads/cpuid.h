@@ -0,0 +1,51 @@
+#ifndef THREADS_CPUID_H
+#define THREADS_CPUID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/flags.h"
+
+/* Feature bits in EDX for CPUID leaf 1.  See [IA32-v2a]
+   "CPUID--CPU Identification". */
+#define CPUID_1_EDX_PSE 0x00000008      /* 4 MB pages. */
+
+/* Returns true if the processor has the CPUID instruction, that
+   is, if software can toggle the ID flag in EFLAGS. */
+static inline bool
+cpuid_supported (void)
+{
+  uint32_t before, after;
+
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl %2, %1;"
+                "pushl %1; popfl; pushfl; popl %1; pushl %0; popfl"
+                : "=&r" (before), "=&r" (after) : "i" (FLAG_ID));
+  return ((before ^ after) & FLAG_ID) != 0;
+}
+
+/* Executes CPUID for LEAF and stores the results into REGS[0]
+   through REGS[3], for EAX, EBX, ECX, and EDX. */
+static inline void
+cpuid (uint32_t leaf, uint32_t regs[4])
+{
+  asm volatile ("cpuid"
+                : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]),
+                  "=d" (regs[3])
+                : "a" (leaf));
+}
+
+/* Returns true if the processor supports 4 MB pages. */
+static inline bool
+cpuid_has_pse (void)
+{
+  uint32_t regs[4];
+
+  if (!cpuid_supported ())
+    return false;
+  cpuid (0, regs);
+  if (regs[0] < 1)
+    return false;
+  cpuid (1, regs);
+  return (regs[3] & CPUID_1_EDX_PSE) != 0;
+}
+
+#endif /* threads/cpuid.h */
@@ -1,5 +1,6 @@
 #include "threads/init.h"
 #include <console.h>
+#include <crc32c.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -15,6 +16,7 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpuid.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -22,6 +24,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -34,14 +37,25 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
+#include "filesys/checksum.h"
+#include "filesys/defrag.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
-#include "vm/frame.c"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* Does init_page_dir map RAM with 4 MB pages? */
+static bool large_pages;
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -58,13 +72,37 @@ static const char *swap_bdev_name;
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* A timed phase of startup, for the boot profile. */
+struct boot_phase
+  {
+    const char *name;           /* Name, e.g. "calibrate timer". */
+    uint64_t start;             /* Time stamp counter at start. */
+    uint64_t end;               /* Time stamp counter at end. */
+  };
+
+/* Boot profile.  Phases may be begun and ended by any thread,
+   so boot_phase_cnt is protected by disabling interrupts. */
+#define BOOT_PHASE_MAX 16
+static struct boot_phase boot_phases[BOOT_PHASE_MAX];
+static size_t boot_phase_cnt;
+static uint64_t boot_tsc;       /* Time stamp counter on entry to main(). */
+
 static void bss_init (void);
 static void paging_init (void);
+static uint32_t *create_kernel_page_dir (bool large);
+static void destroy_kernel_page_dir (uint32_t *pd);
+static void load_page_dir (uint32_t *pd);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
 static void run_actions (char **argv);
+static void run_crc32c_bench (char **argv);
+static void run_paging_bench (char **argv);
+#ifdef USERPROG
+static void run_syscall_bench (char **argv);
+#endif
 static void usage (void);
+static void print_boot_profile (void);
 
 #ifdef FILESYS
 static void locate_block_devices (void);
@@ -77,11 +115,20 @@ int main (void) NO_RETURN;
 int
 main (void)
 {
+  uint64_t entry_tsc = tsc_read ();
+  struct boot_phase *phase;
   char **argv;
 
   /* Clear BSS. */  
   bss_init ();
 
+  /* Start the boot profile, counting the loader's time, which it
+     measured for us, as a phase before our own. */
+  boot_tsc = entry_tsc;
+  phase = boot_phase_begin ("load kernel");
+  phase->start = boot_tsc - loader_cycles;
+  phase->end = boot_tsc;
+
   /* Break command line into arguments and parse options. */
   argv = read_command_line ();
   argv = parse_options (argv);
@@ -96,9 +143,11 @@ main (void)
           init_ram_pages * PGSIZE / 1024);
 
   /* Initialize memory system. */
+  phase = boot_phase_begin ("memory");
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  boot_phase_end (phase);
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -107,6 +156,7 @@ main (void)
 #endif
 
   /* Initialize interrupt handlers. */
+  phase = boot_phase_begin ("interrupts");
   intr_init ();
   timer_init ();
   kbd_init ();
@@ -115,21 +165,41 @@ main (void)
   exception_init ();
   syscall_init ();
 #endif
+  boot_phase_end (phase);
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
+
+  /* Calibrate before starting any other thread, which would skew
+     the measurement. */
+  phase = boot_phase_begin ("calibrate timer");
   timer_calibrate ();
+  boot_phase_end (phase);
 
 #ifdef FILESYS
-  /* Initialize file system. */
+  /* Probe the disk channels in parallel. */
   ide_init ();
+
+  /* Initialize file system. */
+  phase = boot_phase_begin ("register disks");
+  ide_init_finish ();
   locate_block_devices ();
+  boot_phase_end (phase);
+
+  phase = boot_phase_begin ("file system");
   filesys_init (format_filesys);
+  boot_phase_end (phase);
 #endif
 
-  frame_table_init ();
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  page_init ();
+  swap_init ();
+#endif
 
+  print_boot_profile ();
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -139,7 +209,62 @@ main (void)
   shutdown ();
   thread_exit ();
 }
-
+
+/* Starts timing a boot phase called NAME, which must be a string
+   that outlives the boot, and returns it for passing to
+   boot_phase_end().  May be called from any thread.  Returns a
+   null pointer, which boot_phase_end() ignores, if too many
+   phases have been started. */
+struct boot_phase *
+boot_phase_begin (const char *name) 
+{
+  struct boot_phase *phase = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (boot_phase_cnt < BOOT_PHASE_MAX)
+    {
+      phase = &boot_phases[boot_phase_cnt++];
+      phase->name = name;
+      phase->start = tsc_read ();
+      phase->end = 0;
+    }
+  intr_set_level (old_level);
+  return phase;
+}
+
+/* Finishes timing boot PHASE. */
+void
+boot_phase_end (struct boot_phase *phase) 
+{
+  if (phase != NULL)
+    phase->end = tsc_read ();
+}
+
+/* Prints each boot phase's start, relative to the kernel's entry
+   point, and length.  Phases that ran in parallel overlap. */
+static void
+print_boot_profile (void) 
+{
+  size_t i;
+
+  printf ("Boot profile (%'"PRIu64" MHz time stamp counter):\n",
+          timer_tsc_hz () / 1000000);
+  printf ("  %-16s %14s %14s %12s\n",
+          "phase", "start (us)", "cycles", "length (us)");
+  for (i = 0; i < boot_phase_cnt; i++) 
+    {
+      const struct boot_phase *p = &boot_phases[i];
+      uint64_t cycles = p->end > p->start ? p->end - p->start : 0;
+      int64_t start_us = (p->start >= boot_tsc
+                          ? (int64_t) timer_tsc_to_us (p->start - boot_tsc)
+                          : -(int64_t) timer_tsc_to_us (boot_tsc - p->start));
+
+      printf ("  %-16s %'14"PRId64" %'14"PRIu64" %'12"PRIu64"\n",
+              p->name, start_us, cycles, timer_tsc_to_us (cycles));
+    }
+}
+
 /* Clear the "BSS", a segment that should be initialized to
    zeros.  It isn't actually stored on disk or zeroed by the
    kernel loader, so we have to zero it ourselves.
@@ -153,18 +278,45 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
-/* Populates the base page directory and page table with the
+/* Populates the base page directory and page tables with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports 4 MB pages, every 4 MB of RAM that holds
+   no kernel text is mapped with a single large page instead of
+   a page table of 1,024 4 kB pages.  That takes one TLB entry
+   instead of 1,024 and saves the page table. */
 static void
 paging_init (void)
 {
+  large_pages = cpuid_has_pse ();
+  if (large_pages)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+  init_page_dir = create_kernel_page_dir (large_pages);
+  load_page_dir (init_page_dir);
+}
+
+/* Creates and returns a page directory that maps all of RAM at
+   PHYS_BASE, with the kernel's text read-only.  If LARGE is
+   true, which requires CR4_PSE to be set, uses a 4 MB page for
+   each 4 MB-aligned 4 MB of RAM that holds no kernel text; the
+   rest of RAM, including the kernel's text, is mapped with 4 kB
+   pages so that the text stays read-only. */
+static uint32_t *
+create_kernel_page_dir (bool large)
+{
+  extern char _start, _end_kernel_text;
+  uintptr_t text_start = vtop (&_start);
+  uintptr_t text_end = vtop (&_end_kernel_text);
   uint32_t *pd, *pt;
   size_t page;
-  extern char _start, _end_kernel_text;
 
-  pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  pd = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
   for (page = 0; page < init_ram_pages; page++)
     {
@@ -174,6 +326,15 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (large && pte_idx == 0
+          && init_ram_pages - page >= PTSPAN / PGSIZE
+          && (paddr + PTSPAN <= text_start || paddr >= text_end))
+        {
+          pd[pde_idx] = pde_create_large (vaddr);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -182,13 +343,31 @@ paging_init (void)
 
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
+  return pd;
+}
+
+/* Frees page directory PD, created by create_kernel_page_dir(),
+   and its page tables. */
+static void
+destroy_kernel_page_dir (uint32_t *pd)
+{
+  size_t i;
 
-  /* Store the physical address of the page directory into CR3
-     aka PDBR (page directory base register).  This activates our
-     new page tables immediately.  See [IA32-v2a] "MOV--Move
-     to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
-     of the Page Directory". */
-  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+  for (i = pd_no (PHYS_BASE); i < PGSIZE / sizeof *pd; i++)
+    if ((pd[i] & PTE_P) && !(pd[i] & PTE_PS))
+      palloc_free_page (pde_get_pt (pd[i]));
+  palloc_free_page (pd);
+}
+
+/* Stores the physical address of page directory PD into CR3 aka
+   PDBR (page directory base register).  This activates PD
+   immediately and flushes the TLB.  See [IA32-v2a] "MOV--Move
+   to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
+   of the Page Directory". */
+static void
+load_page_dir (uint32_t *pd)
+{
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -250,9 +429,23 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-flush-age"))
+        cache_set_flush_age (atoi (value));
+      else if (!strcmp (name, "-dirty-ratio"))
+        cache_set_dirty_ratio (atoi (value));
+      else if (!strcmp (name, "-checksum"))
+        checksum_enable ();
+      else if (!strcmp (name, "-defrag"))
+        defrag_set_interval (atoi (value));
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-stack"))
+        page_set_stack_limit (atoi (value));
+      else if (!strcmp (name, "-fault-around"))
+        page_set_fault_around (atoi (value));
+      else if (!strcmp (name, "-zswap"))
+        zswap_set_pool_size (atoi (value));
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -295,6 +488,159 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Checksums BUFFER, which is PGSIZE bytes long, with CRC over
+   and over for about a second and prints the throughput. */
+static void
+bench_crc32c (const char *name,
+              uint32_t (*crc) (uint32_t, const void *, size_t),
+              const uint8_t *buffer)
+{
+  unsigned long long bytes = 0, mb_per_s;
+  uint32_t sum = 0;
+  int64_t start, elapsed;
+
+  /* Start on a tick boundary. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+
+  start = timer_ticks ();
+  do
+    {
+      sum = crc (sum, buffer, PGSIZE);
+      bytes += PGSIZE;
+      elapsed = timer_elapsed (start);
+    }
+  while (elapsed < TIMER_FREQ);
+
+  mb_per_s = bytes * TIMER_FREQ / elapsed / 1000000;
+  printf ("%-16s %6llu MB/s (%llu.%02llu GB/s), crc %08"PRIx32"\n",
+          name, mb_per_s, mb_per_s / 1000, mb_per_s % 1000 / 10, sum);
+}
+
+/* Compares the throughput of the slicing-by-8 CRC-32C used for
+   file system checksums against the byte-at-a-time algorithm.
+   Both should report the same final crc. */
+static void
+run_crc32c_bench (char **argv UNUSED)
+{
+  uint8_t *buffer = palloc_get_page (PAL_ASSERT);
+
+  random_bytes (buffer, PGSIZE);
+  bench_crc32c ("byte-at-a-time", crc32c_bytewise, buffer);
+  bench_crc32c ("slicing-by-8", crc32c, buffer);
+  palloc_free_page (buffer);
+}
+
+/* Number of passes bench_paging() makes over RAM. */
+#define PAGING_BENCH_PASSES 32
+
+/* Touches one byte in each page of the kernel's mapping of RAM,
+   PAGING_BENCH_PASSES times over, flushing the TLB before each pass as every
+   switch between processes does, under a kernel page directory
+   created with create_kernel_page_dir (LARGE), and prints the
+   cycles taken per page. */
+static void
+bench_paging (const char *name, bool large)
+{
+  uint32_t *pd = create_kernel_page_dir (large);
+  size_t page_tables = 0;
+  enum intr_level old_level;
+  volatile uint8_t sink = 0;
+  uint64_t start, cycles;
+  size_t i, pass, page;
+
+  for (i = pd_no (PHYS_BASE); i < PGSIZE / sizeof *pd; i++)
+    if ((pd[i] & PTE_P) && !(pd[i] & PTE_PS))
+      page_tables++;
+
+  /* A thread switch would load init_page_dir. */
+  old_level = intr_disable ();
+  load_page_dir (pd);
+  start = tsc_read ();
+  for (pass = 0; pass < PAGING_BENCH_PASSES; pass++)
+    {
+      load_page_dir (pd);
+      for (page = 0; page < init_ram_pages; page++)
+        sink += *(uint8_t *) ptov (page * PGSIZE);
+    }
+  cycles = tsc_read () - start;
+  load_page_dir (init_page_dir);
+  intr_set_level (old_level);
+
+  destroy_kernel_page_dir (pd);
+  printf ("%-12s %4llu cycles per page, %3zu page tables\n", name,
+          (unsigned long long) (cycles / (PAGING_BENCH_PASSES
+                                          * init_ram_pages)),
+          page_tables);
+}
+
+/* Compares the cost of TLB misses on kernel memory with RAM
+   mapped by 4 kB pages against 4 MB pages.  The 4 MB region that
+   holds the kernel's text is mapped with 4 kB pages either way,
+   so the two differ only with more than 4 MB of RAM: run with,
+   say, `pintos -m 64'. */
+static void
+run_paging_bench (char **argv UNUSED)
+{
+  bench_paging ("4 kB pages", false);
+  if (large_pages)
+    bench_paging ("4 MB pages", true);
+  else
+    printf ("4 MB pages   not supported by this CPU\n");
+}
+
+#ifdef USERPROG
+/* Runs the program in TASK to completion, with the kernel half of
+   its page directory copied from a kernel page directory created
+   with create_kernel_page_dir (LARGE), and prints the time
+   taken. */
+static void
+bench_syscalls (const char *name, const char *task, bool large)
+{
+  uint32_t *pd = create_kernel_page_dir (large);
+  uint32_t *old_pd = init_page_dir;
+  enum intr_level old_level;
+  uint64_t cycles, hz;
+
+  /* New processes copy their kernel mappings from init_page_dir,
+     and threads without a process load it. */
+  init_page_dir = pd;
+  cycles = tsc_read ();
+  process_wait (process_execute (task));
+  cycles = tsc_read () - cycles;
+
+  /* The process is gone, and every thread reloads its page
+     directory when it next runs, so only this thread may still
+     be using PD. */
+  old_level = intr_disable ();
+  init_page_dir = old_pd;
+  load_page_dir (init_page_dir);
+  intr_set_level (old_level);
+  destroy_kernel_page_dir (pd);
+
+  hz = timer_tsc_hz ();
+  printf ("%-12s %6llu ms\n", name,
+          (unsigned long long) (hz != 0 ? cycles * 1000 / hz : 0));
+}
+
+/* Runs the system call heavy program in ARGV[1], for example
+   examples/sysbench, with RAM mapped by 4 kB pages and then by
+   4 MB pages, after one untimed run to warm the caches.  As with
+   paging-bench, the two differ only with more than 4 MB of
+   RAM. */
+static void
+run_syscall_bench (char **argv)
+{
+  process_wait (process_execute (argv[1]));
+  bench_syscalls ("4 kB pages", argv[1], false);
+  if (large_pages)
+    bench_syscalls ("4 MB pages", argv[1], true);
+  else
+    printf ("4 MB pages   not supported by this CPU\n");
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -312,6 +658,11 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"crc32c-bench", 1, run_crc32c_bench},
+      {"paging-bench", 1, run_paging_bench},
+#ifdef USERPROG
+      {"syscall-bench", 2, run_syscall_bench},
+#endif
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -359,6 +710,13 @@ usage (void)
           "  run 'PROG [ARG...]' Run PROG and wait for it to complete.\n"
 #else
           "  run TEST           Run TEST.\n"
+#endif
+          "  crc32c-bench       Measure CRC-32C throughput.\n"
+          "  paging-bench       Compare kernel TLB misses, 4 kB vs 4 MB pages.\n"
+#ifdef USERPROG
+          "  syscall-bench 'PROG [ARG...]'\n"
+          "                     Time PROG, such as sysbench, with 4 kB vs 4 MB\n"
+          "                     pages.  Both benchmarks need over 4 MB of RAM.\n"
 #endif
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
@@ -376,8 +734,15 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -flush-age=MS      Write back cached data after MS ms dirty.\n"
+          "  -dirty-ratio=PCT   Write back early once PCT%% of cache is dirty.\n"
+          "  -checksum          Keep and verify per-sector checksums.\n"
+          "  -defrag=SECS       Defragment files in the background every SECS s.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -stack=COUNT       Let user stacks grow to COUNT pages.\n"
+          "  -fault-around=N    Map windows of N pages around faults.\n"
+          "  -zswap=COUNT       Compress swapped pages into COUNT pages of RAM.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
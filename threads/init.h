@@ -9,4 +9,9 @@
 /* Page directory with kernel mappings only. */
 extern uint32_t *init_page_dir;
 
+/* Boot profiling. */
+struct boot_phase;
+struct boot_phase *boot_phase_begin (const char *name);
+void boot_phase_end (struct boot_phase *);
+
 #endif /* threads/init.h */
@@ -35,6 +35,9 @@
 
 /* Amount of physical memory, in 4 kB pages. */
 extern uint32_t init_ram_pages;
+
+/* Time stamp counter cycles taken to load the kernel. */
+extern uint32_t loader_cycles;
 #endif
 
 #endif /* threads/loader.h */
@@ -51,7 +51,10 @@ static inline uintptr_t pd_no (const void *va) {
    |         Physical Address           |         Flags          |
    +------------------------------------+------------------------+
 
-   In a PDE, the physical address points to a page table.
+   In a PDE, the physical address points to a page table, unless
+   PTE_PS is set, in which case the PDE maps a 4 MB page of
+   memory at that (4 MB-aligned) address directly; the CPU must
+   support this and have it enabled with CR4_PSE.
    In a PTE, the physical address points to a data or code page.
    The important flags are listed below.
    When a PDE or PTE is not "present", the other flags are
@@ -66,6 +69,10 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
+
+/* CR4 bit that enables PDEs with PTE_PS. */
+#define CR4_PSE 0x10
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -73,10 +80,20 @@ static inline uint32_t pde_create (uint32_t *pt) {
   return vtop (pt) | PTE_U | PTE_P | PTE_W;
 }
 
+/* Returns a PDE that maps the 4 MB page of memory at PAGE,
+   which must be 4 MB-aligned, readable and writable by ring 0
+   code only. */
+static inline uint32_t pde_create_large (void *page) {
+  ASSERT (vtop (page) % PTSPAN == 0);
+  return vtop (page) | PTE_PS | PTE_P | PTE_W;
+}
+
 /* Returns a pointer to the page table that page directory entry
-   PDE, which must "present", points to. */
+   PDE, which must "present" and not map a 4 MB page, points
+   to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
   ASSERT (pde & PTE_P);
+  ASSERT (!(pde & PTE_PS));
   return ptov (pde & PTE_ADDR);
 }
 
@@ -260,6 +260,24 @@ lock_held_by_current_thread (const struct lock *lock)
 
   return lock->holder == thread_current ();
 }
+
+/* Returns true if some thread is waiting to acquire LOCK, which
+   the current thread must hold, so that the holder of a
+   contended lock can choose to give it up sooner. */
+bool
+lock_has_waiters (struct lock *lock) 
+{
+  enum intr_level old_level;
+  bool waiters;
+
+  ASSERT (lock != NULL);
+  ASSERT (lock_held_by_current_thread (lock));
+
+  old_level = intr_disable ();
+  waiters = !list_empty (&lock->semaphore.waiters);
+  intr_set_level (old_level);
+  return waiters;
+}
 
 /* One semaphore in a list. */
 struct semaphore_elem 
@@ -39,6 +39,7 @@ void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+bool lock_has_waiters (struct lock *);
 
 /* Condition variable. */
 struct condition 
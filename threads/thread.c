@@ -19,11 +19,12 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
-#include "vm/page.c"
-#include "lib/kernel/hash.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
+#ifdef FILESYS
+#include "filesys/directory.h"
+#endif
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -206,6 +207,12 @@ thread_create (const char *name, int priority,
   intr_set_level (old_level);
   /* end of Zach driving. */
 
+#ifdef FILESYS
+  /* Start out in the creator's current directory. */
+  if (t->parent != NULL && t->parent->current_directory != NULL)
+    t->current_directory = dir_reopen (t->parent->current_directory);
+#endif
+
   tid = t->tid = allocate_tid ();   
 
   /* Stack frame for kernel_thread(). */
@@ -496,8 +503,6 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init (&t->children);
   sema_init (&t->child_exit_sema, 0);
   sema_init (&t->parent_wait_sema, 0);
-
-  hash_init (&t->supp_page_table, &pt_hash_func, &pt_less_func, NULL);
   /* end of Connie driving. */
 
   old_level = intr_disable();
@@ -15,6 +15,8 @@
 #include "synch.h"
 #include "lib/kernel/hash.h"
 
+struct dir;
+
 /* States in a thread's life cycle. */
 enum thread_status
   {
@@ -126,11 +128,22 @@ struct thread
 
     struct file *open_files[MAX_FD_COUNT];  /* Process's open files. 
                                                Index through fd. */
-    struct file *current_directory;     /* Current directory - inherited */
+    struct dir *current_directory;      /* Current directory - inherited.
+                                           Null means the root. */
     /* end of Zach, Cindy, and Connie driving. */
 
-    struct hash supp_page_table;          /* Extra info about pages
-                                              in page directory */
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash supp_page_table;        /* Supplemental page table. */
+    struct list pinned_pages;           /* Pages pinned by a syscall. */
+
+    /* Owned by userprog/syscall.c. */
+    void *user_esp;                     /* User esp at syscall entry. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+#endif
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -13,7 +13,11 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -158,6 +162,35 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  if (is_user_vaddr (fault_addr))
+    {
+      /* A page of the process's address space that is not
+         resident yet, or a new page of its stack, touched either
+         by the process or by the kernel on its behalf.  In the
+         latter case f->esp is the kernel's stack pointer, so use
+         the one saved at system call entry.  A zero page that the
+         process only reads is mapped to the shared zero page.  A
+         fault by the process also maps the pages around it that
+         are at hand. */
+      if (not_present
+          && ((user && !write && page_map_zero (fault_addr))
+              || page_in (fault_addr)
+              || page_grow_stack (fault_addr,
+                                  user ? f->esp
+                                  : thread_current ()->user_esp)))
+        {
+          if (user)
+            page_fault_around (fault_addr);
+          return;
+        }
+
+      /* First write to a page mapped to the shared zero page. */
+      if (!not_present && write && page_copy_on_write (fault_addr))
+        return;
+    }
+#endif
+
   validate_pointer (fault_addr);
 
   /* To implement virtual memory, delete the rest of the function
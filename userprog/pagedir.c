@@ -8,6 +8,8 @@
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (struct pagedir_batch *, uint32_t *pd,
+                             const void *upage);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -142,6 +144,15 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
    UPAGE need not be mapped. */
 void
 pagedir_clear_page (uint32_t *pd, void *upage) 
+{
+  pagedir_batch_clear_page (NULL, pd, upage);
+}
+
+/* Like pagedir_clear_page(), but if BATCH is nonnull, leaves the
+   TLB invalidation to pagedir_batch_end(). */
+void
+pagedir_batch_clear_page (struct pagedir_batch *batch,
+                          uint32_t *pd, void *upage) 
 {
   uint32_t *pte;
 
@@ -152,7 +163,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (batch, pd, upage);
     }
 }
 
@@ -180,7 +191,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (NULL, pd, vpage);
         }
     }
 }
@@ -200,6 +211,15 @@ pagedir_is_accessed (uint32_t *pd, const void *vpage)
    VPAGE in PD. */
 void
 pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed) 
+{
+  pagedir_batch_set_accessed (NULL, pd, vpage, accessed);
+}
+
+/* Like pagedir_set_accessed(), but if BATCH is nonnull, leaves
+   the TLB invalidation to pagedir_batch_end(). */
+void
+pagedir_batch_set_accessed (struct pagedir_batch *batch, uint32_t *pd,
+                            const void *vpage, bool accessed) 
 {
   uint32_t *pte = lookup_page (pd, vpage, false);
   if (pte != NULL) 
@@ -209,11 +229,49 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (batch, pd, vpage);
         }
     }
 }
 
+/* Begins a batch of page table changes.  Changes made through
+   the pagedir_batch_*() functions with BATCH do not invalidate
+   the TLB one at a time; pagedir_batch_end() does it for all of
+   them at once.  Until then the CPU may keep using the old
+   entries, so the caller must not let user code run in the
+   affected address space, or depend on the change taking effect,
+   before ending the batch.
+
+   A batch may span page directories.  Only changes to the page
+   directory that is active at the time are recorded, since
+   entries of other page directories are not in the TLB, and
+   switching page directories flushes the whole TLB anyway. */
+void
+pagedir_batch_begin (struct pagedir_batch *batch) 
+{
+  batch->cnt = 0;
+}
+
+/* Ends BATCH, invalidating the TLB entries of the pages it
+   changed.  Up to PAGEDIR_BATCH_PAGES pages are invalidated one
+   by one with INVLPG, which keeps the rest of the TLB intact;
+   beyond that a single flush of the whole TLB is cheaper than
+   that many INVLPGs and the refills they save. */
+void
+pagedir_batch_end (struct pagedir_batch *batch) 
+{
+  if (batch->cnt > PAGEDIR_BATCH_PAGES)
+    invalidate_pagedir (active_pd ());
+  else 
+    {
+      size_t i;
+
+      for (i = 0; i < batch->cnt; i++)
+        asm volatile ("invlpg (%0)" : : "r" (batch->pages[i]) : "memory");
+    }
+  batch->cnt = 0;
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
@@ -261,3 +319,25 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Invalidates the TLB entry for user virtual page UPAGE if PD is
+   the active page directory, or, if BATCH is nonnull, records
+   UPAGE in BATCH for pagedir_batch_end() to invalidate later.
+   INVLPG drops only UPAGE's entry, so unlike re-activating PD it
+   does not cost the rest of the address space its TLB entries.
+   See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (struct pagedir_batch *batch, uint32_t *pd,
+                 const void *upage) 
+{
+  if (active_pd () != pd)
+    return;
+  if (batch == NULL)
+    asm volatile ("invlpg (%0)" : : "r" (upage) : "memory");
+  else 
+    {
+      if (batch->cnt < PAGEDIR_BATCH_PAGES)
+        batch->pages[batch->cnt] = upage;
+      batch->cnt++;
+    }
+}
@@ -2,8 +2,21 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Most pages a batch invalidates one at a time; see
+   pagedir_batch_end(). */
+#define PAGEDIR_BATCH_PAGES 32
+
+/* A batch of page table changes whose TLB invalidation is
+   deferred until the batch ends. */
+struct pagedir_batch
+  {
+    size_t cnt;                 /* Number of pages changed. */
+    const void *pages[PAGEDIR_BATCH_PAGES]; /* The first pages changed. */
+  };
+
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
@@ -15,4 +28,12 @@ bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate (uint32_t *pd);
 
+/* Batched changes. */
+void pagedir_batch_begin (struct pagedir_batch *);
+void pagedir_batch_clear_page (struct pagedir_batch *, uint32_t *pd,
+                               void *upage);
+void pagedir_batch_set_accessed (struct pagedir_batch *, uint32_t *pd,
+                                 const void *upage, bool accessed);
+void pagedir_batch_end (struct pagedir_batch *);
+
 #endif /* userprog/pagedir.h */
@@ -28,6 +28,10 @@
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "lib/kernel/list.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
@@ -150,11 +154,21 @@ process_exit (void)
       sema_up (&list_entry (e, struct thread, child_elem)->child_exit_sema);
     }
 
+  lock_acquire (&filesys_lock);
+  dir_close (cur->current_directory);
+  cur->current_directory = NULL;
+  lock_release (&filesys_lock);
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
   if (pd != NULL) 
     {
+#ifdef VM
+      mmap_unmap_all ();
+      page_table_destroy ();
+#endif
+
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -167,6 +181,15 @@ process_exit (void)
       pagedir_destroy (pd);
     }
 
+  /* Close the executable only now that none of the process's
+     pages refers to it.  Until then writes to it stay denied, and
+     the frames shared with other processes running it, which are
+     found by its inode, cannot outlive the inode. */
+  lock_acquire (&filesys_lock);
+  file_close (cur->file);
+  cur->file = NULL;
+  lock_release (&filesys_lock);
+
   if (cur->parent != NULL)
     {
       sema_down (&cur->child_exit_sema);
@@ -295,11 +318,15 @@ load (const char *cmdline, void (**eip) (void), void **esp)
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
+#ifdef VM
+  page_table_init ();
+  mmap_init ();
+#endif
   process_activate ();
 
   /* Open executable file. */
   lock_acquire (&filesys_lock);
-  file = filesys_open (file_name);
+  file = filesys_open_at (t->current_directory, file_name);
   lock_release (&filesys_lock);
 
   if (file == NULL) 
@@ -403,7 +430,9 @@ load (const char *cmdline, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -462,6 +491,10 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With virtual memory, the pages are only recorded in the
+   supplemental page table here and read in when first touched,
+   so FILE must stay open while the process runs.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -472,7 +505,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Calculate how to fill this page.
@@ -481,6 +516,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from. */
+      if (page_read_bytes > 0
+          ? !page_add_file (upage, file, ofs, page_read_bytes, writable)
+          : !page_add_zero (upage, writable))
+        return false;
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -500,13 +543,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
-      struct frame_table_entry *new_entry;
-      new_entry = malloc(sizeof(struct frame_table_entry));
-      new_entry->pd = thread_current ()->pagedir;
-      new_entry->upage = upage;
-      new_entry->owner = thread_current ();
-      new_entry->pinned = false;
-      frame_table[kpage] = new_entry;
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -539,71 +576,78 @@ setup_stack (void **esp, const char *cmdline)
   int arg_iterator;
   uint32_t i;
 
+#ifdef VM
+  /* The first stack page is brought in right away because the
+     arguments go there. */
+  kpage = NULL;
+  success = (page_add_zero (((uint8_t *) PHYS_BASE) - PGSIZE, true)
+             && page_in (((uint8_t *) PHYS_BASE) - PGSIZE));
+#else
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL) 
+  success = (kpage != NULL
+             && install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true));
+#endif
+  if (success) 
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success) 
+      *esp = PHYS_BASE;
+      strlcpy (buf, cmdline, sizeof (local_copy));
+      /* Parse arguments and store in parsed array. */
+      while ((token = strtok_r (buf, " ", &buf))) 
         {
-          *esp = PHYS_BASE;
-          strlcpy (buf, cmdline, sizeof (local_copy));
-          /* Parse arguments and store in parsed array. */
-          while ((token = strtok_r (buf, " ", &buf))) 
-            {
-              parsed[argc] = token;
-              argc++;
-            }
-          
-          /* Push arguments onto stack. */
-          for (arg_iterator = argc - 1; arg_iterator >= 0; arg_iterator--)
-            {
-              arg_size = strlen (parsed[arg_iterator]) + 1;
-              *esp -= arg_size;
-              validate_pointer (*esp);
-              memcpy (*esp, parsed[arg_iterator], arg_size);
-              arg_addresses[arg_iterator] = *esp;
-            }
-
-          /* Word align between array data and pointers to them. */
-          before_word_align = ((uint32_t) *esp) % 4;
-          if (before_word_align != 0)
-            {
-              for (i = 0; i < before_word_align; i++)
-                *esp -= 1; 
-            }
+          parsed[argc] = token;
+          argc++;
+        }
+      
+      /* Push arguments onto stack. */
+      for (arg_iterator = argc - 1; arg_iterator >= 0; arg_iterator--)
+        {
+          arg_size = strlen (parsed[arg_iterator]) + 1;
+          *esp -= arg_size;
           validate_pointer (*esp);
+          memcpy (*esp, parsed[arg_iterator], arg_size);
+          arg_addresses[arg_iterator] = *esp;
+        }
 
-          /* Check for stack overflow. */
-          predicted_esp = *esp - (argc + 4) * 4;
-          validate_pointer (predicted_esp);
-         
-          /* Null sentinel. */
-          *esp -= sizeof (char *);
-          /* Push pointers to argument data onto stack. */          
-          for (arg_iterator = argc - 1; arg_iterator >= 0; arg_iterator--)
-            {
-              arg_size = sizeof (arg_addresses[arg_iterator]);
-              *esp -= arg_size;
-              memcpy (*esp, &arg_addresses[arg_iterator], arg_size);
-            }
- 
-          /* Push on pointer to argv */
-          memcpy ((*esp - sizeof (char *)), esp, sizeof (char *));
-          *esp -= sizeof (char *);         
-          /* Push the argc on */
-          *esp -= sizeof (int);
-          memcpy (*esp, &argc, sizeof (int));
-          /* Push on a fake return address. */
-          *esp -= sizeof (void *);
-          memcpy (*esp, &null_pointer, sizeof (void *));
+      /* Word align between array data and pointers to them. */
+      before_word_align = ((uint32_t) *esp) % 4;
+      if (before_word_align != 0)
+        {
+          for (i = 0; i < before_word_align; i++)
+            *esp -= 1; 
         }
-      else
-        palloc_free_page (kpage);
+      validate_pointer (*esp);
+
+      /* Check for stack overflow. */
+      predicted_esp = *esp - (argc + 4) * 4;
+      validate_pointer (predicted_esp);
+     
+      /* Null sentinel. */
+      *esp -= sizeof (char *);
+      /* Push pointers to argument data onto stack. */          
+      for (arg_iterator = argc - 1; arg_iterator >= 0; arg_iterator--)
+        {
+          arg_size = sizeof (arg_addresses[arg_iterator]);
+          *esp -= arg_size;
+          memcpy (*esp, &arg_addresses[arg_iterator], arg_size);
+        }
+ 
+      /* Push on pointer to argv */
+      memcpy ((*esp - sizeof (char *)), esp, sizeof (char *));
+      *esp -= sizeof (char *);         
+      /* Push the argc on */
+      *esp -= sizeof (int);
+      memcpy (*esp, &argc, sizeof (int));
+      /* Push on a fake return address. */
+      *esp -= sizeof (void *);
+      memcpy (*esp, &null_pointer, sizeof (void *));
     }
+  else if (kpage != NULL)
+    palloc_free_page (kpage);
   return success;
 }
 /* end of Cindy, Zach, and Connie driving. */
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -623,3 +667,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
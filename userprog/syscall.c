@@ -7,10 +7,13 @@
  * Date: 10/27/17
  */
 #include "userprog/syscall.h"
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <syscall-nr.h>
 #include <string.h>
+#include <dirent.h>
+#include <uio.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
@@ -21,15 +24,32 @@
 #include "userprog/process.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
 #include "filesys/off_t.h"
 #include "lib/kernel/list.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
-#define MAX_ARGS 3
+#define MAX_ARGS 4
 #define FD_START 2
 #define BLOCK_SIZE 200
 #define CODE_SEG_START 0x08048000
 
 static void syscall_handler (struct intr_frame *);
+static struct dir *fd_dir_begin (int fd);
+static void fd_dir_end (int fd, struct dir *dir);
+static struct dir *at_dir_open (int dirfd);
+static int fd_install (struct file *file);
+static void validate_iov (const struct iovec *iov, int iovcnt);
+static bool valid_range (unsigned offset, unsigned size);
+static off_t read_file (struct file *, void *, off_t size);
+static off_t write_file (struct file *, const void *, off_t size);
+static off_t read_file_at (struct file *, void *, off_t size, off_t ofs);
+static off_t write_file_at (struct file *, const void *, off_t size,
+                            off_t ofs);
 
 void
 syscall_init (void) 
@@ -43,6 +63,9 @@ static void
 syscall_handler (struct intr_frame *f) 
 {
   int arguments[MAX_ARGS];
+#ifdef VM
+  thread_current ()->user_esp = f->esp;
+#endif
   validate_pointer ((const void *) f->esp);
 
   switch (*((int *) f->esp)) 
@@ -109,7 +132,122 @@ syscall_handler (struct intr_frame *f)
         get_arg (arguments, f->esp, 1);
         close_handler ((int) arguments[0]);
         break;
+#ifdef VM
+      case SYS_MMAP :
+        get_arg (arguments, f->esp, 2);
+        f->eax = mmap_handler ((int) arguments[0], (void *) arguments[1]);
+        break;
+      case SYS_MUNMAP :
+        get_arg (arguments, f->esp, 1);
+        munmap_handler ((mapid_t) arguments[0]);
+        break;
+#endif
+      case SYS_CHDIR :
+        get_arg (arguments, f->esp, 1);
+        validate_pointer ((const void *) arguments[0]);
+        f->eax = chdir_handler ((const char *) arguments[0]);
+        break;
+      case SYS_MKDIR :
+        get_arg (arguments, f->esp, 1);
+        validate_pointer ((const void *) arguments[0]);
+        f->eax = mkdir_handler ((const char *) arguments[0]);
+        break;
+      case SYS_READDIR :
+        get_arg (arguments, f->esp, 2);
+        validate_buffer ((const void *) arguments[1], NAME_MAX + 1);
+        f->eax = readdir_handler ((int) arguments[0], (char *) arguments[1]);
+        break;
+      case SYS_ISDIR :
+        get_arg (arguments, f->esp, 1);
+        f->eax = isdir_handler ((int) arguments[0]);
+        break;
+      case SYS_INUMBER :
+        get_arg (arguments, f->esp, 1);
+        f->eax = inumber_handler ((int) arguments[0]);
+        break;
+      case SYS_GETDENTS :
+        get_arg (arguments, f->esp, 3);
+        validate_buffer ((const void *) arguments[1], arguments[2]);
+        f->eax = getdents_handler ((int) arguments[0], (void *) arguments[1],
+                                   (unsigned) arguments[2]);
+        break;
+      case SYS_OPENAT :
+        get_arg (arguments, f->esp, 2);
+        validate_pointer ((const void *) arguments[1]);
+        f->eax = openat_handler ((int) arguments[0], 
+                                 (const char *) arguments[1]);
+        break;
+      case SYS_MKDIRAT :
+        get_arg (arguments, f->esp, 2);
+        validate_pointer ((const void *) arguments[1]);
+        f->eax = mkdirat_handler ((int) arguments[0], 
+                                  (const char *) arguments[1]);
+        break;
+      case SYS_UNLINKAT :
+        get_arg (arguments, f->esp, 2);
+        validate_pointer ((const void *) arguments[1]);
+        f->eax = unlinkat_handler ((int) arguments[0], 
+                                   (const char *) arguments[1]);
+        break;
+      case SYS_FALLOCATE :
+        get_arg (arguments, f->esp, 3);
+        f->eax = fallocate_handler ((int) arguments[0], 
+                                    (unsigned) arguments[1],
+                                    (unsigned) arguments[2]);
+        break;
+      case SYS_FSYNC :
+        get_arg (arguments, f->esp, 1);
+        f->eax = fsync_handler ((int) arguments[0]);
+        break;
+      case SYS_SYNC :
+        sync_handler ();
+        break;
+      case SYS_COPY_FILE_RANGE :
+        get_arg (arguments, f->esp, 3);
+        f->eax = copy_file_range_handler ((int) arguments[0],
+                                          (int) arguments[1],
+                                          (unsigned) arguments[2]);
+        break;
+      case SYS_PREAD :
+        get_arg (arguments, f->esp, 4);
+        validate_buffer ((const void *) arguments[1], arguments[2]);
+        f->eax = pread_handler ((int) arguments[0], (void *) arguments[1],
+                                (unsigned) arguments[2],
+                                (unsigned) arguments[3]);
+        break;
+      case SYS_PWRITE :
+        get_arg (arguments, f->esp, 4);
+        validate_buffer ((const void *) arguments[1], arguments[2]);
+        f->eax = pwrite_handler ((int) arguments[0],
+                                 (const void *) arguments[1],
+                                 (unsigned) arguments[2],
+                                 (unsigned) arguments[3]);
+        break;
+      case SYS_READV :
+        get_arg (arguments, f->esp, 3);
+        validate_iov ((const struct iovec *) arguments[1], arguments[2]);
+        f->eax = readv_handler ((int) arguments[0],
+                                (const struct iovec *) arguments[1],
+                                (int) arguments[2]);
+        break;
+      case SYS_WRITEV :
+        get_arg (arguments, f->esp, 3);
+        validate_iov ((const struct iovec *) arguments[1], arguments[2]);
+        f->eax = writev_handler ((int) arguments[0],
+                                 (const struct iovec *) arguments[1],
+                                 (int) arguments[2]);
+        break;
+      case SYS_OPEN_FLAGS :
+        get_arg (arguments, f->esp, 2);
+        validate_pointer ((const void *) arguments[0]);
+        f->eax = open_flags_handler ((const char *) arguments[0],
+                                     (int) arguments[1]);
+        break;
     }
+
+#ifdef VM
+  page_unpin_all ();
+#endif
 }
 /* end of Cindy and Connie driving. */
 
@@ -146,9 +284,6 @@ exit_handler (int status)
 {
   struct thread *cur = thread_current ();
   
-  lock_acquire (&filesys_lock); 
-  file_close (cur->file);
-  lock_release (&filesys_lock);
   printf ("%s: exit(%d)\n", cur->name, status);
 
   cur->exit_status = status;  
@@ -169,7 +304,8 @@ exec_handler (const char *cmd_line)
 
   /* Check that file exists. */
   lock_acquire (&filesys_lock);
-  struct file *file = filesys_open(file_name);
+  struct file *file = filesys_open_at (thread_current ()->current_directory,
+                                       file_name);
   if (file == NULL)
     {
       file_close(file);
@@ -206,7 +342,8 @@ bool
 create_handler (const char *file, unsigned initial_size)
 {
   lock_acquire (&filesys_lock);
-  bool created = filesys_create (file, (off_t) initial_size);
+  bool created = filesys_create_at (thread_current ()->current_directory,
+                                    file, (off_t) initial_size, false);
   lock_release (&filesys_lock);
   return created;
 }
@@ -219,7 +356,8 @@ bool
 remove_handler (const char *file)
 {
   lock_acquire (&filesys_lock);
-  bool removed = filesys_remove (file);
+  bool removed = filesys_remove_at (thread_current ()->current_directory,
+                                    file);
   lock_release (&filesys_lock);
   return removed;
 }
@@ -232,27 +370,7 @@ remove_handler (const char *file)
 int 
 open_handler (const char *file)
 {
-  int fd_index;
-  struct thread *cur = thread_current ();
-
-  lock_acquire (&filesys_lock);
-  /* Iterate through array of open files to find a free space.
-     Return the index of that space as the fd. */
-  for (fd_index = FD_START; fd_index < MAX_FD_COUNT; fd_index++)
-    {
-      if (cur->open_files[fd_index] == NULL)
-        {
-          cur->open_files[fd_index] = filesys_open (file);
-          if (cur->open_files[fd_index] != NULL)
-            {
-              cur->open_files[fd_index] = filesys_open (file);
-              lock_release (&filesys_lock);
-              return fd_index;
-            }
-        }
-    }
-  lock_release (&filesys_lock);
-  return -1;
+  return openat_handler (AT_FDCWD, file);
 }
 /* end of Zach and Cindy driving. */
 
@@ -297,7 +415,7 @@ read_handler (int fd, void *buffer, unsigned size)
     return -1;
 
   lock_acquire (&filesys_lock);
-  size_read = file_read (file, buffer, (off_t) size);
+  size_read = read_file (file, buffer, (off_t) size);
   lock_release (&filesys_lock);
   return size_read;
 }
@@ -330,11 +448,11 @@ write_handler (int fd, const void *buffer, unsigned size)
     return -1;
 
   struct file *file = thread_current ()->open_files[fd];
-  if (file == NULL)
+  if (file == NULL || inode_is_dir (file_get_inode (file)))
     return -1;
 
   lock_acquire (&filesys_lock);
-  off_t bytes_written = file_write (file, buffer, (off_t) size);
+  off_t bytes_written = write_file (file, buffer, (off_t) size);
   lock_release (&filesys_lock);
   return bytes_written;
 }
@@ -384,13 +502,48 @@ close_handler (int fd)
 }  
 /* end of Connie driving. */
 
+#ifdef VM
+/* Maps the file open as fd into consecutive pages starting at
+   addr.  Returns the mapping's identifier, or MAP_FAILED if fd
+   is not an open ordinary file or the pages are not free. */
+mapid_t
+mmap_handler (int fd, void *addr)
+{
+  struct file *file;
+
+  if (!valid_fd (fd) || thread_current ()->open_files[fd] == NULL)
+    return MAP_FAILED;
+  file = thread_current ()->open_files[fd];
+  if (inode_is_dir (file_get_inode (file)))
+    return MAP_FAILED;
+  return mmap_map (file, addr);
+}
+
+/* Unmaps mapping, writing back the pages that were written. */
+void
+munmap_handler (mapid_t mapping)
+{
+  mmap_unmap (mapping);
+}
+#endif
+
 /* 
 Changes the current working directory of the process to dir, 
 which may be relative or absolute. Returns true if successful, false on failure. 
 */
 bool chdir_handler (const char *dir)
 {
+  struct thread *cur = thread_current ();
 
+  lock_acquire (&filesys_lock);
+  struct dir *new_dir = filesys_open_dir_at (cur->current_directory, dir);
+  if (new_dir != NULL)
+    {
+      dir_close (cur->current_directory);
+      cur->current_directory = new_dir;
+    }
+  lock_release (&filesys_lock);
+  return new_dir != NULL;
 }
 
 /*
@@ -402,7 +555,7 @@ already exists and "/a/b/c" does not.
 */
 bool mkdir_handler (const char *dir)
 {
-
+  return mkdirat_handler (AT_FDCWD, dir);
 }
 
 /*
@@ -413,7 +566,14 @@ If no entries are left in the directory, returns false.
 */
 bool readdir_handler (int fd, char *name)
 {
+  bool success;
 
+  lock_acquire (&filesys_lock);
+  struct dir *dir = fd_dir_begin (fd);
+  success = dir != NULL && dir_readdir (dir, name);
+  fd_dir_end (fd, dir);
+  lock_release (&filesys_lock);
+  return success;
 }
 
 /*
@@ -422,7 +582,14 @@ an ordinary file.
 */
 bool isdir_handler (int fd)
 {
+  if (!valid_fd (fd) || thread_current ()->open_files[fd] == NULL)
+    return false;
 
+  lock_acquire (&filesys_lock);
+  bool is_dir = inode_is_dir (file_get_inode (
+                                thread_current ()->open_files[fd]));
+  lock_release (&filesys_lock);
+  return is_dir;
 }
 
 /*
@@ -434,45 +601,558 @@ number of the inode is suitable for use as an inode number.
 */
 int inumber_handler (int fd)
 {
-  
+  if (!valid_fd (fd) || thread_current ()->open_files[fd] == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  int inumber = inode_get_inumber (file_get_inode (
+                                     thread_current ()->open_files[fd]));
+  lock_release (&filesys_lock);
+  return inumber;
+}
+
+/* Fills BUFFER, SIZE bytes long, with as many packed `struct
+   dirent' records from directory fd as fit, continuing from
+   where the last readdir() or getdents() on fd left off.
+   Returns the number of bytes filled, 0 if no entries are left,
+   or -1 if fd is not a directory or the next entry does not fit
+   in BUFFER at all. */
+int
+getdents_handler (int fd, void *buffer, unsigned size)
+{
+  char name[NAME_MAX + 1];
+  block_sector_t inumber;
+  bool is_dir;
+  bool overflow = false;
+  unsigned used = 0;
+  off_t pos;
+
+  lock_acquire (&filesys_lock);
+  struct dir *dir = fd_dir_begin (fd);
+  if (dir == NULL)
+    {
+      lock_release (&filesys_lock);
+      return -1;
+    }
+
+  for (pos = dir_tell (dir); 
+       dir_readdir_entry (dir, name, &inumber, &is_dir);
+       pos = dir_tell (dir))
+    {
+      size_t namlen = strlen (name);
+      struct dirent *d = (struct dirent *) ((uint8_t *) buffer + used);
+
+      /* Leave an entry that does not fit for the next call. */
+      if (DIRENT_RECLEN (namlen) > size - used)
+        {
+          dir_seek (dir, pos);
+          overflow = true;
+          break;
+        }
+
+      d->d_ino = inumber;
+      d->d_reclen = DIRENT_RECLEN (namlen);
+      d->d_type = is_dir ? DT_DIR : DT_REG;
+      d->d_namlen = namlen;
+      memcpy (d->d_name, name, namlen + 1);
+      used += d->d_reclen;
+    }
+  fd_dir_end (fd, dir);
+  lock_release (&filesys_lock);
+
+  if (used == 0 && overflow)
+    return -1;
+  return used;
+}
+
+/* Opens PATH relative to the directory open as DIRFD, or to the
+   current directory if DIRFD is AT_FDCWD.  Returns a new file
+   descriptor, or -1 if DIRFD is not a directory or PATH cannot
+   be opened.  A process that holds a directory open skips
+   resolving the path that leads to it on every call. */
+int
+openat_handler (int dirfd, const char *path)
+{
+  int fd;
+
+  lock_acquire (&filesys_lock);
+  struct dir *dir = at_dir_open (dirfd);
+  struct file *file = dir != NULL ? filesys_open_at (dir, path) : NULL;
+  dir_close (dir);
+
+  fd = fd_install (file);
+  if (fd == -1)
+    file_close (file);
+  lock_release (&filesys_lock);
+  return fd;
+}
+
+/* Creates the directory PATH relative to DIRFD as for openat().
+   Returns true if successful, false on failure. */
+bool
+mkdirat_handler (int dirfd, const char *path)
+{
+  lock_acquire (&filesys_lock);
+  struct dir *dir = at_dir_open (dirfd);
+  bool created = dir != NULL && filesys_create_at (dir, path, 0, true);
+  dir_close (dir);
+  lock_release (&filesys_lock);
+  return created;
+}
+
+/* Deletes the file or empty directory PATH relative to DIRFD as
+   for openat().  Returns true if successful, false on failure. */
+bool
+unlinkat_handler (int dirfd, const char *path)
+{
+  lock_acquire (&filesys_lock);
+  struct dir *dir = at_dir_open (dirfd);
+  bool removed = dir != NULL && filesys_remove_at (dir, path);
+  dir_close (dir);
+  lock_release (&filesys_lock);
+  return removed;
+}
+
+/* Reserves disk space for bytes OFFSET through OFFSET + LENGTH
+   of the ordinary file open as fd, allocating it as
+   contiguously as possible.  The file's length and contents are
+   unchanged; later writes into the reserved range do not need to
+   allocate.  Returns true if successful, false on failure. */
+bool
+fallocate_handler (int fd, unsigned offset, unsigned length)
+{
+  struct file *file;
+  bool success;
+
+  if (!valid_fd (fd) || offset + length < offset
+      || offset + length > INT_MAX)
+    return false;
+  file = thread_current ()->open_files[fd];
+  if (file == NULL || inode_is_dir (file_get_inode (file)))
+    return false;
+
+  lock_acquire (&filesys_lock);
+  success = file_reserve (file, (off_t) (offset + length));
+  lock_release (&filesys_lock);
+  return success;
+}
+
+/* Writes the data and metadata of the file or directory open as
+   FD that are still cached in memory back to disk.  Returns
+   true if successful, false if FD is not open. */
+bool
+fsync_handler (int fd)
+{
+  struct file *file;
+
+  if (!valid_fd (fd))
+    return false;
+  file = thread_current ()->open_files[fd];
+  if (file == NULL)
+    return false;
+
+  lock_acquire (&filesys_lock);
+  file_sync (file);
+  lock_release (&filesys_lock);
+  return true;
+}
+
+/* Writes all cached file system data back to disk. */
+void
+sync_handler (void)
+{
+  lock_acquire (&filesys_lock);
+  filesys_sync ();
+  lock_release (&filesys_lock);
+}
+
+/* Copies up to SIZE bytes from the file open as FD_IN, starting
+   at its position, to the file open as FD_OUT at its position,
+   without passing the data through user memory.  Advances both
+   positions.  Returns the number of bytes copied, or -1 if
+   either fd is not an open ordinary file or both name the same
+   file. */
+int
+copy_file_range_handler (int fd_in, int fd_out, unsigned size)
+{
+  struct file *in, *out;
+  int bytes_copied;
+
+  if (!valid_fd (fd_in) || !valid_fd (fd_out))
+    return -1;
+  in = thread_current ()->open_files[fd_in];
+  out = thread_current ()->open_files[fd_out];
+  if (in == NULL || out == NULL
+      || inode_is_dir (file_get_inode (in))
+      || inode_is_dir (file_get_inode (out)))
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  bytes_copied = file_copy_range (in, out, (off_t) size);
+  lock_release (&filesys_lock);
+  return bytes_copied;
+}
+
+/* Opens FILE as open() does, with FLAGS changing how the new
+   file descriptor behaves.  O_DIRECT makes reads and writes of
+   whole sectors bypass the page cache; it is not allowed on
+   directories.  Returns the new fd, or -1 if FILE cannot be
+   opened or FLAGS is invalid. */
+int
+open_flags_handler (const char *file, int flags)
+{
+  int fd;
+
+  if ((flags & ~O_DIRECT) != 0)
+    return -1;
+
+  fd = open_handler (file);
+  if (fd != -1 && (flags & O_DIRECT))
+    {
+      struct file *f = thread_current ()->open_files[fd];
+      if (inode_is_dir (file_get_inode (f)))
+        {
+          close_handler (fd);
+          return -1;
+        }
+      file_set_direct (f, true);
+    }
+  return fd;
+}
+
+/* Reads SIZE bytes from the file open as FD into BUFFER,
+   starting at byte OFFSET in the file, without using or moving
+   the file's position.  Returns the number of bytes read, which
+   is less than SIZE at end of file, or -1 if FD is not an open
+   file. */
+int
+pread_handler (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  struct file *file;
+  int size_read;
+
+  if (!valid_fd (fd) || !valid_range (offset, size))
+    return -1;
+  file = thread_current ()->open_files[fd];
+  if (file == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  size_read = read_file_at (file, buffer, (off_t) size, (off_t) offset);
+  lock_release (&filesys_lock);
+  return size_read;
+}
+
+/* Writes SIZE bytes from BUFFER to the file open as FD, starting
+   at byte OFFSET in the file, without using or moving the file's
+   position.  Returns the number of bytes written, or -1 if FD is
+   not an open ordinary file. */
+int
+pwrite_handler (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  struct file *file;
+  int bytes_written;
+
+  if (!valid_fd (fd) || !valid_range (offset, size))
+    return -1;
+  file = thread_current ()->open_files[fd];
+  if (file == NULL || inode_is_dir (file_get_inode (file)))
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  bytes_written = write_file_at (file, buffer, (off_t) size,
+                                 (off_t) offset);
+  lock_release (&filesys_lock);
+  return bytes_written;
+}
+
+/* Reads from FD into the IOVCNT buffers described by IOV, filling
+   each before moving on to the next, as one read() of their
+   total length would.  Returns the number of bytes read, which
+   is less than the total at end of file, or -1 if FD is not
+   open. */
+int
+readv_handler (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file *file;
+  int size_read = 0;
+  int i;
+
+  if (fd == STDIN_FILENO)
+    {
+      for (i = 0; i < iovcnt; i++)
+        size_read += read_handler (fd, iov[i].iov_base, iov[i].iov_len);
+      return size_read;
+    }
+
+  if (!valid_fd (fd))
+    return -1;
+  file = thread_current ()->open_files[fd];
+  if (file == NULL)
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  for (i = 0; i < iovcnt; i++)
+    {
+      off_t n = read_file (file, iov[i].iov_base, (off_t) iov[i].iov_len);
+      size_read += n;
+      if ((size_t) n < iov[i].iov_len)
+        break;
+    }
+  lock_release (&filesys_lock);
+  return size_read;
+}
+
+/* Writes the IOVCNT buffers described by IOV to FD in order, as
+   one write() of their total length would.  Returns the number
+   of bytes written, or -1 if FD is not open or is a directory. */
+int
+writev_handler (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file *file;
+  int bytes_written = 0;
+  int i;
+
+  if (fd == STDOUT_FILENO)
+    {
+      for (i = 0; i < iovcnt; i++)
+        bytes_written += write_handler (fd, iov[i].iov_base, iov[i].iov_len);
+      return bytes_written;
+    }
+
+  if (!valid_fd (fd))
+    return -1;
+  file = thread_current ()->open_files[fd];
+  if (file == NULL || inode_is_dir (file_get_inode (file)))
+    return -1;
+
+  lock_acquire (&filesys_lock);
+  for (i = 0; i < iovcnt; i++)
+    {
+      off_t n = write_file (file, iov[i].iov_base, (off_t) iov[i].iov_len);
+      bytes_written += n;
+      if ((size_t) n < iov[i].iov_len)
+        break;
+    }
+  lock_release (&filesys_lock);
+  return bytes_written;
+}
+
+/* Checks that IOV is a valid array of IOVCNT buffer descriptors,
+   with at most IOV_MAX of them, each naming a valid buffer.  If
+   not, the running process is terminated. */
+static void
+validate_iov (const struct iovec *iov, int iovcnt)
+{
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    exit_handler (-1);
+  validate_buffer (iov, iovcnt * sizeof *iov);
+  for (i = 0; i < iovcnt; i++)
+    validate_buffer (iov[i].iov_base, iov[i].iov_len);
+}
+
+/* Opens the directory that the *at() calls resolve relative
+   paths against: the current directory if DIRFD is AT_FDCWD,
+   otherwise the directory open as DIRFD.  Returns a null pointer
+   if DIRFD is neither.  The caller must hold filesys_lock and
+   close the result. */
+static struct dir *
+at_dir_open (int dirfd)
+{
+  struct thread *cur = thread_current ();
+  struct file *file;
+
+  if (dirfd == AT_FDCWD)
+    return (cur->current_directory != NULL
+            ? dir_reopen (cur->current_directory) : dir_open_root ());
+
+  if (!valid_fd (dirfd))
+    return NULL;
+  file = cur->open_files[dirfd];
+  if (file == NULL || !inode_is_dir (file_get_inode (file)))
+    return NULL;
+  return dir_open (inode_reopen (file_get_inode (file)));
+}
+
+/* Stores FILE in the lowest free slot of the current process's
+   open file table and returns its index as the fd, or returns
+   -1 if FILE is null or the table is full. */
+static int
+fd_install (struct file *file)
+{
+  struct thread *cur = thread_current ();
+  int fd_index;
+
+  if (file == NULL)
+    return -1;
+  for (fd_index = FD_START; fd_index < MAX_FD_COUNT; fd_index++)
+    if (cur->open_files[fd_index] == NULL)
+      {
+        cur->open_files[fd_index] = file;
+        return fd_index;
+      }
+  return -1;
+}
+
+/* Opens a directory over the inode of fd, positioned at fd's
+   current position, for reading entries.  Returns a null
+   pointer if fd is not an open directory.  The caller must hold
+   filesys_lock and pass the result to fd_dir_end(). */
+static struct dir *
+fd_dir_begin (int fd)
+{
+  struct file *file;
+  struct dir *dir;
+
+  if (!valid_fd (fd))
+    return NULL;
+  file = thread_current ()->open_files[fd];
+  if (file == NULL || !inode_is_dir (file_get_inode (file)))
+    return NULL;
+
+  dir = dir_open (inode_reopen (file_get_inode (file)));
+  if (dir != NULL)
+    dir_seek (dir, file_tell (file));
+  return dir;
+}
+
+/* Saves DIR's position back into fd and closes DIR. */
+static void
+fd_dir_end (int fd, struct dir *dir)
+{
+  if (dir == NULL)
+    return;
+  file_seek (thread_current ()->open_files[fd], dir_tell (dir));
+  dir_close (dir);
 }
 
 /* Zach and Cindy drove here. */
 /* Checks if a pointer passed in is a null pointer, a pointer
    to unmapped virtual memory, or a pointer to kernel virtual
-   address space. If so, the running process is terminated. */
+   address space. If so, the running process is terminated.
+   With virtual memory, a valid page that is not resident yet is
+   brought in, so that the system call does not fault on it
+   later while holding a lock. */
 void 
 validate_pointer (const void *pointer)
 {
  
-  if (pointer == NULL || is_kernel_vaddr (pointer) || 
-      pagedir_get_page (thread_current ()->pagedir, pointer) == NULL)
+  if (pointer == NULL || is_kernel_vaddr (pointer))
     exit_handler (-1);
+  if (pagedir_get_page (thread_current ()->pagedir, pointer) == NULL)
+    {
+#ifdef VM
+      if (page_in (pointer)
+          || page_grow_stack (pointer, thread_current ()->user_esp))
+        return;
+#endif
+      exit_handler (-1);
+    }
 }
 
 /* Checks if a buffer passed in is valid. 
-   If not, the running process is terminated. */
+   If not, the running process is terminated.
+   With virtual memory, the buffer is also kept resident until
+   the system call returns, so that copying to or from it under
+   the file system's locks cannot fault.  Each page is pinned as
+   soon as it checks out, so that bringing in later pages cannot
+   evict it. */
 void
 validate_buffer (const void *buffer, unsigned size) 
 {
   unsigned i;
   unsigned pointer_size = sizeof (const void *);
   unsigned num_pointers = size / pointer_size;
+#ifdef VM
+  const void *pinned_page = NULL;
+#endif
 
   if (size % pointer_size != 0)
     num_pointers++;
 
   for (i = 0; i < num_pointers; i++)
-    validate_pointer ((const void *) (((int *) buffer) + i));
+    {
+      const void *pointer = ((int *) buffer) + i;
+
+      validate_pointer (pointer);
+#ifdef VM
+      if (pg_round_down (pointer) != pinned_page)
+        {
+          if (!page_pin_buffer (pointer, 1))
+            exit_handler (-1);
+          pinned_page = pg_round_down (pointer);
+        }
+#endif
+    }
 }
 
 /* Checks if fd is in range of array. If not, return false. */
 bool
 valid_fd (int fd)
 {
-  if ((fd < FD_START) || (fd > MAX_FD_COUNT))
+  if ((fd < FD_START) || (fd >= MAX_FD_COUNT))
     return false;
   return true;
 }
 /* end of Zach and Cindy driving. */
 
+/* Reads SIZE bytes from FILE into BUFFER at FILE's position and
+   advances the position, as file_read() does, but through
+   read_file_at(). */
+static off_t
+read_file (struct file *file, void *buffer, off_t size)
+{
+  off_t bytes_read = read_file_at (file, buffer, size, file_tell (file));
+  file_seek (file, file_tell (file) + bytes_read);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into FILE at FILE's position and
+   advances the position, as file_write() does, but through
+   write_file_at(). */
+static off_t
+write_file (struct file *file, const void *buffer, off_t size)
+{
+  off_t bytes_written = write_file_at (file, buffer, size, file_tell (file));
+  file_seek (file, file_tell (file) + bytes_written);
+  return bytes_written;
+}
+
+/* Reads SIZE bytes from FILE into BUFFER starting at offset OFS,
+   as file_read_at() does.  With virtual memory, stores made
+   through mappings of FILE are written back first, so that the
+   read sees them.  The caller must hold filesys_lock. */
+static off_t
+read_file_at (struct file *file, void *buffer, off_t size, off_t ofs)
+{
+#ifdef VM
+  mmap_flush_range (file, ofs, size);
+#endif
+  return file_read_at (file, buffer, size, ofs);
+}
+
+/* Writes SIZE bytes from BUFFER into FILE starting at offset OFS,
+   as file_write_at() does.  With virtual memory, the bytes
+   written are also copied into resident pages of mappings of
+   FILE, so that the mappings show them.  The caller must hold
+   filesys_lock. */
+static off_t
+write_file_at (struct file *file, const void *buffer, off_t size, off_t ofs)
+{
+  off_t bytes_written = file_write_at (file, buffer, size, ofs);
+#ifdef VM
+  mmap_update_range (file, ofs, buffer, bytes_written);
+#endif
+  return bytes_written;
+}
+
+/* Returns true if the SIZE bytes starting at file offset OFFSET
+   all lie at offsets that an off_t can represent. */
+static bool
+valid_range (unsigned offset, unsigned size)
+{
+  return offset <= INT_MAX && size <= INT_MAX - offset;
+}
+
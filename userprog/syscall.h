@@ -11,8 +11,11 @@
 
 #include <stdbool.h>
 
+struct iovec;
+
 /* Connie driving now. */
 typedef int pid_t;
+typedef int mapid_t;
 
 /* Global lock for filesys. */
 struct lock filesys_lock;
@@ -35,12 +38,28 @@ int write_handler (int fd, const void *buffer, unsigned size);
 void seek_handler (int fd, unsigned position);
 unsigned tell_handler (int fd);
 void close_handler (int fd);
+mapid_t mmap_handler (int fd, void *addr);
+void munmap_handler (mapid_t mapping);
 
 bool chdir_handler (const char *dir);
 bool mkdir_handler (const char *dir);
 bool readdir_handler (int fd, char *name);
 bool isdir_handler (int fd);
 int inumber_handler (int fd);
+int getdents_handler (int fd, void *buffer, unsigned size);
+int openat_handler (int dirfd, const char *path);
+bool mkdirat_handler (int dirfd, const char *path);
+bool unlinkat_handler (int dirfd, const char *path);
+bool fallocate_handler (int fd, unsigned offset, unsigned length);
+bool fsync_handler (int fd);
+void sync_handler (void);
+int copy_file_range_handler (int fd_in, int fd_out, unsigned size);
+int pread_handler (int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite_handler (int fd, const void *buffer, unsigned size,
+                    unsigned offset);
+int readv_handler (int fd, const struct iovec *iov, int iovcnt);
+int writev_handler (int fd, const struct iovec *iov, int iovcnt);
+int open_flags_handler (const char *file, int flags);
 
 /* Error-checking functions. */
 void validate_pointer (const void *pointer);
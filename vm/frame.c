@@ -0,0 +1,526 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <hash.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   At startup the frame table takes every page of the user pool
+   from palloc, so that it knows about all of the frames that
+   user pages can occupy.  Free frames are handed out first.
+   When none is left, a page is evicted with the clock
+   (second-chance) algorithm: the clock hand sweeps the frames in
+   order, and a page whose accessed bit is set has the bit
+   cleared and is passed over once.  Each step of the hand either
+   clears a bit or finds a victim, so eviction takes O(1)
+   amortized steps.
+
+   A victim that has been written must go to swap.  The hand then
+   goes on a little further to gather up to SWAP_CLUSTER such
+   pages, which are written out together; the frames beyond the
+   first go on the free list for the faults that follow.
+
+   Read-only pages of executables are shared: every process that
+   runs a given executable maps the same frame for a given page
+   of its text, found by inode and offset in `shares', so that
+   running a program that is already running reads nothing from
+   disk and takes no new frames for its text.  Such a frame
+   belongs to a `struct share' rather than to a page.  It is
+   evicted only when none of the processes mapping it has
+   accessed it since the clock hand last passed, and then it is
+   unmapped from all of them at once; it is freed when the last
+   of them goes away. */
+
+/* A page of an executable shared among processes. */
+struct share
+  {
+    struct hash_elem elem;      /* Element in `shares'. */
+    struct inode *inode;        /* Executable, kept open by mappers. */
+    off_t ofs;                  /* Offset of the page in the file. */
+    size_t read_bytes;          /* Bytes read from the file. */
+    struct frame *frame;        /* Frame holding it, if resident. */
+    struct list pages;          /* Pages that map it. */
+    int busy;                   /* Pages being mapped to it. */
+    bool loading;               /* Frame being filled? */
+  };
+
+/* How far the clock hand looks past the first page that must be
+   written for others to write along with it. */
+#define GATHER_STEPS (4 * SWAP_CLUSTER)
+
+static struct frame *frames;            /* All frames. */
+static size_t frame_cnt;                /* Number of frames. */
+static struct list free_frames;         /* Frames not holding a page. */
+static size_t clock_hand;               /* Next eviction candidate. */
+static struct hash shares;              /* Shared pages. */
+static struct condition share_loaded;   /* Signaled when loading ends. */
+static struct lock frame_lock;          /* Protects all of the above. */
+
+static struct share *lookup_share (struct page *);
+static struct frame *get_frame (void);
+static struct frame *evict (struct pagedir_batch *);
+static bool evict_share (struct frame *, struct pagedir_batch *);
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+
+/* Initializes the frame table with all of the user pool's
+   pages. */
+void
+frame_init (void)
+{
+  void *pages = NULL;
+  void *kpage;
+  size_t i;
+
+  lock_init (&frame_lock);
+  list_init (&free_frames);
+  hash_init (&shares, share_hash, share_less, NULL);
+  cond_init (&share_loaded);
+
+  /* Drain the user pool, chaining the pages through their first
+     word, to learn how many there are. */
+  while ((kpage = palloc_get_page (PAL_USER)) != NULL)
+    {
+      *(void **) kpage = pages;
+      pages = kpage;
+      frame_cnt++;
+    }
+
+  frames = calloc (frame_cnt, sizeof *frames);
+  if (frames == NULL && frame_cnt > 0)
+    PANIC ("no memory for frame table");
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame *f = &frames[i];
+      f->kpage = pages;
+      pages = *(void **) pages;
+      list_push_back (&free_frames, &f->free_elem);
+    }
+}
+
+/* Gives page P a frame, evicting another page if necessary, and
+   returns it, or a null pointer if every frame holds a page that
+   cannot be evicted.  The frame comes back pinned, so that it is
+   not evicted while the caller fills it; call frame_unpin()
+   once P is mapped. */
+struct frame *
+frame_alloc (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  if (p->frame != NULL)
+    {
+      /* P kept its frame after all, because swap filled up while
+         P was being evicted. */
+      f = p->frame;
+      f->pinned = true;
+    }
+  else
+    {
+      f = get_frame ();
+      if (f != NULL)
+        {
+          f->page = p;
+          f->pinned = true;
+          p->frame = f;
+        }
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Like frame_alloc(), but only takes a free frame, never
+   evicting a page.  For reading ahead. */
+struct frame *
+frame_try_alloc (struct page *p)
+{
+  struct frame *f = NULL;
+
+  lock_acquire (&frame_lock);
+  if (!list_empty (&free_frames))
+    {
+      f = list_entry (list_pop_front (&free_frames), struct frame, free_elem);
+      f->page = p;
+      f->pinned = true;
+      p->frame = f;
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Pins page P's frame, if it has one, so that it is not
+   evicted, waiting for an eviction already under way.  Returns
+   true if P is resident and now pinned, false if it has no
+   frame. */
+bool
+frame_pin (struct page *p)
+{
+  bool resident;
+
+  lock_acquire (&frame_lock);
+  resident = p->frame != NULL;
+  if (resident)
+    p->frame->pinned = true;
+  lock_release (&frame_lock);
+  return resident;
+}
+
+/* Marks page P pinned, so that it is not evicted whether or not
+   it is resident now, waiting for an eviction already under way
+   that found P unpinned.  Clearing P->pinned unpins it. */
+void
+frame_pin_page (struct page *p)
+{
+  lock_acquire (&frame_lock);
+  p->pinned = true;
+  lock_release (&frame_lock);
+}
+
+/* Allows F to be evicted again. */
+void
+frame_unpin (struct frame *f)
+{
+  f->pinned = false;
+}
+
+/* Calls page_sync_mmap() with OFS, SIZE and DATA for each
+   resident page of a mapping of INODE, in any process. */
+void
+frame_sync_mmap (struct inode *inode, off_t ofs, off_t size,
+                 const void *data)
+{
+  size_t i;
+
+  lock_acquire (&frame_lock);
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct page *p = frames[i].page;
+      if (p != NULL && p->type == PAGE_MMAP
+          && file_get_inode (p->file) == inode)
+        page_sync_mmap (p, ofs, size, data);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Releases page P's frame, if it has one, to the free list.
+   The caller must already have unmapped P. */
+void
+frame_free (struct page *p)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = p->frame;
+  if (f != NULL)
+    {
+      p->frame = NULL;
+      f->page = NULL;
+      f->pinned = false;
+      list_push_back (&free_frames, &f->free_elem);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Gives page P, a read-only page of an executable, the frame
+   that the processes running the executable share for it, and
+   returns it, or a null pointer if memory is short.  If no
+   process has the page resident, a frame is allocated for it,
+   evicting another page if necessary, and *FILL is set to true:
+   the caller must fill the frame.  Otherwise *FILL is set to
+   false and the frame is returned as soon as it is filled.
+   Either way the frame stays put until frame_share_put(). */
+struct frame *
+frame_share_get (struct page *p, bool *fill)
+{
+  struct share *s = p->share;
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  if (s == NULL)
+    {
+      s = lookup_share (p);
+      if (s == NULL)
+        {
+          s = malloc (sizeof *s);
+          if (s == NULL)
+            {
+              lock_release (&frame_lock);
+              return NULL;
+            }
+          s->inode = file_get_inode (p->file);
+          s->ofs = p->ofs;
+          s->read_bytes = p->read_bytes;
+          s->frame = NULL;
+          list_init (&s->pages);
+          s->busy = 0;
+          s->loading = false;
+          hash_insert (&shares, &s->elem);
+        }
+      list_push_back (&s->pages, &p->share_elem);
+      p->share = s;
+    }
+
+  while (s->loading)
+    cond_wait (&share_loaded, &frame_lock);
+  *fill = s->frame == NULL;
+  if (*fill)
+    {
+      f = get_frame ();
+      if (f == NULL)
+        {
+          lock_release (&frame_lock);
+          return NULL;
+        }
+      f->page = NULL;
+      f->share = s;
+      s->frame = f;
+      s->loading = true;
+    }
+  f = s->frame;
+  s->busy++;
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Ends the use of page P's shared frame begun by
+   frame_share_get(), which allows it to be evicted again.  If
+   the caller filled the frame, LOADED tells whether that
+   succeeded. */
+void
+frame_share_put (struct page *p, bool loaded)
+{
+  struct share *s = p->share;
+
+  lock_acquire (&frame_lock);
+  s->busy--;
+  if (s->loading)
+    {
+      s->loading = false;
+      if (!loaded)
+        {
+          s->frame->share = NULL;
+          list_push_back (&free_frames, &s->frame->free_elem);
+          s->frame = NULL;
+        }
+      cond_broadcast (&share_loaded, &frame_lock);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Maps read-only executable page P to its shared frame if some
+   process already has the page resident, without reading it or
+   allocating a frame, for faulting around.  Returns true if
+   successful. */
+bool
+frame_share_map (struct page *p)
+{
+  struct share *s;
+  bool mapped = false;
+
+  lock_acquire (&frame_lock);
+  s = p->share != NULL ? p->share : lookup_share (p);
+  if (s != NULL && s->frame != NULL && !s->loading
+      && pagedir_set_page (p->owner->pagedir, p->upage, s->frame->kpage,
+                           false))
+    {
+      if (p->share == NULL)
+        {
+          list_push_back (&s->pages, &p->share_elem);
+          p->share = s;
+        }
+      mapped = true;
+    }
+  lock_release (&frame_lock);
+  return mapped;
+}
+
+/* Unmaps page P from its shared frame, if it has one, and stops
+   sharing it, freeing the frame if P was its last user. */
+void
+frame_share_release (struct page *p)
+{
+  struct share *s = p->share;
+
+  if (s == NULL)
+    return;
+
+  lock_acquire (&frame_lock);
+  pagedir_clear_page (p->owner->pagedir, p->upage);
+  list_remove (&p->share_elem);
+  p->share = NULL;
+  if (list_empty (&s->pages))
+    {
+      if (s->frame != NULL)
+        {
+          s->frame->share = NULL;
+          list_push_back (&free_frames, &s->frame->free_elem);
+        }
+      hash_delete (&shares, &s->elem);
+      free (s);
+    }
+  lock_release (&frame_lock);
+}
+
+/* Returns the share for read-only executable page P, or a null
+   pointer if no process has one for it.  The caller must hold
+   frame_lock. */
+static struct share *
+lookup_share (struct page *p)
+{
+  struct share key;
+  struct hash_elem *e;
+
+  key.inode = file_get_inode (p->file);
+  key.ofs = p->ofs;
+  key.read_bytes = p->read_bytes;
+  e = hash_find (&shares, &key.elem);
+  return e != NULL ? hash_entry (e, struct share, elem) : NULL;
+}
+
+/* Returns a free frame, evicting a page if none is free, or a
+   null pointer if no page can be evicted.  The caller must hold
+   frame_lock. */
+static struct frame *
+get_frame (void)
+{
+  struct pagedir_batch batch;
+  struct frame *f;
+
+  if (!list_empty (&free_frames))
+    return list_entry (list_pop_front (&free_frames), struct frame, free_elem);
+
+  /* The clock sweep may clear the accessed bits of many pages in
+     the current process; invalidate their TLB entries at once. */
+  pagedir_batch_begin (&batch);
+  f = evict (&batch);
+  pagedir_batch_end (&batch);
+  return f;
+}
+
+/* Chooses a page to evict with the clock algorithm, evicts it,
+   and returns its frame.  Returns a null pointer if no page can
+   be evicted.  Page table changes that need not take effect
+   until the frame is reused are made as part of BATCH.  The
+   caller must hold frame_lock, which also keeps the victim's
+   owner from destroying the victim meanwhile. */
+static struct frame *
+evict (struct pagedir_batch *batch)
+{
+  struct frame *cluster[SWAP_CLUSTER];
+  struct page *pages[SWAP_CLUSTER];
+  size_t limit, cnt, written;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  /* The first sweep may only clear accessed bits; the second is
+     sure to find any page that can be evicted at all. */
+  limit = 2 * frame_cnt;
+  cnt = 0;
+  for (i = 0; i < limit && cnt < SWAP_CLUSTER; i++)
+    {
+      struct frame *f = &frames[clock_hand];
+      clock_hand = (clock_hand + 1) % frame_cnt;
+
+      if (f->share != NULL)
+        {
+          if (cnt == 0 && evict_share (f, batch))
+            return f;
+          continue;
+        }
+      if (f->page == NULL || f->pinned || f->page->pinned
+          || page_accessed_recently (f->page, batch))
+        continue;
+      if (cnt == 0 && page_out (f->page))
+        return f;
+      if (page_needs_write (f->page))
+        {
+          if (cnt == 0 && i + GATHER_STEPS < limit)
+            limit = i + GATHER_STEPS;
+          cluster[cnt++] = f;
+        }
+    }
+  if (cnt == 0)
+    return NULL;
+
+  /* Write the gathered pages to swap. */
+  for (i = 0; i < cnt; i++)
+    pages[i] = cluster[i]->page;
+  written = page_swap_out (pages, cnt);
+  if (written == 0)
+    return NULL;
+  for (i = 1; i < written; i++)
+    {
+      cluster[i]->page = NULL;
+      list_push_back (&free_frames, &cluster[i]->free_elem);
+    }
+  cluster[0]->page = NULL;
+  return cluster[0];
+}
+
+/* Evicts shared frame F if it is not in use and none of the
+   pages that map it has been accessed recently, unmapping it
+   from all of them as part of BATCH.  Returns true if
+   successful.  The caller must hold frame_lock. */
+static bool
+evict_share (struct frame *f, struct pagedir_batch *batch)
+{
+  struct share *s = f->share;
+  bool accessed = false;
+  struct list_elem *e;
+
+  if (s->busy > 0 || f->pinned)
+    return false;
+  for (e = list_begin (&s->pages); e != list_end (&s->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, share_elem);
+      if (p->pinned)
+        return false;
+      if (page_accessed_recently (p, batch))
+        accessed = true;
+    }
+  if (accessed)
+    return false;
+
+  for (e = list_begin (&s->pages); e != list_end (&s->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, share_elem);
+      pagedir_batch_clear_page (batch, p->owner->pagedir, p->upage);
+    }
+  s->frame = NULL;
+  f->share = NULL;
+  return true;
+}
+
+/* Returns a hash value for the share whose element is E. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct share *s = hash_entry (e, struct share, elem);
+  return hash_bytes (&s->inode, sizeof s->inode) ^ hash_int (s->ofs);
+}
+
+/* Returns true if share A precedes share B. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct share *a = hash_entry (a_, struct share, elem);
+  const struct share *b = hash_entry (b_, struct share, elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
@@ -0,0 +1,37 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <stdbool.h>
+#include <list.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+struct share;
+
+/* A frame of physical memory in the user pool. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address. */
+    struct page *page;          /* Page held, or null if free. */
+    struct share *share;        /* Shared text held, or null. */
+    bool pinned;                /* Being filled, not to be evicted? */
+    struct list_elem free_elem; /* Element in free list, if free. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_try_alloc (struct page *);
+bool frame_pin (struct page *);
+void frame_pin_page (struct page *);
+void frame_unpin (struct frame *);
+void frame_free (struct page *);
+void frame_sync_mmap (struct inode *, off_t ofs, off_t size, const void *);
+
+/* Read-only executable pages shared among processes. */
+struct frame *frame_share_get (struct page *, bool *fill);
+void frame_share_put (struct page *, bool loaded);
+bool frame_share_map (struct page *);
+void frame_share_release (struct page *);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,213 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   A mapping makes the pages of a file appear at consecutive user
+   pages.  Nothing is read when the mapping is made: each page is
+   a PAGE_MMAP page in the supplemental page table and is read
+   through the file system's page cache on first touch, like an
+   executable's pages.  Pages that the process writes are written
+   back to the file when they are evicted and when the mapping
+   goes away, by munmap() or at exit; pages that were only read
+   are simply dropped.
+
+   A mapped page is a copy of the file's data, not the page cache
+   page itself, so read() and write() keep the two coherent: a
+   read of a mapped file first writes back the resident mapped
+   pages that it covers, and a write copies the new data into
+   them as well.  Both go through every process's mappings of the
+   file, but cost nothing while no file is mapped. */
+
+/* A mapping. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in owner's mappings. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* File mapped, reopened. */
+    uint8_t *base;              /* First user page. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+/* Number of mappings in all processes.  Protected by
+   filesys_lock. */
+static int mapping_cnt;
+
+static struct mapping *lookup_mapping (mapid_t);
+static void unmap (struct mapping *);
+
+/* Initializes the current process's list of mappings. */
+void
+mmap_init (void)
+{
+  struct thread *t = thread_current ();
+
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+}
+
+/* Maps FILE, which must be open, into the current process's
+   address space starting at ADDR, and returns the new mapping's
+   identifier.  Fails, returning MAP_FAILED, if ADDR is null or
+   not page-aligned, if FILE is empty, or if any page of the
+   range is outside user space, already in use, or reserved for
+   the stack to grow into. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+
+  lock_acquire (&filesys_lock);
+  length = file_length (file);
+  lock_release (&filesys_lock);
+  if (length == 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = m->base + i * PGSIZE;
+      if (!is_user_vaddr (upage) || page_is_stack (upage)
+          || page_lookup (upage) != NULL)
+        {
+          free (m);
+          return MAP_FAILED;
+        }
+    }
+
+  lock_acquire (&filesys_lock);
+  m->file = file_reopen (file);
+  if (m->file != NULL)
+    mapping_cnt++;
+  lock_release (&filesys_lock);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      if (!page_add_mmap (m->base + ofs, m->file, ofs, read_bytes))
+        {
+          m->page_cnt = i;
+          unmap (m);
+          return MAP_FAILED;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Unmaps the current process's mapping MAPID, if it exists,
+   writing back the pages that were written. */
+void
+mmap_unmap (mapid_t mapid)
+{
+  struct mapping *m = lookup_mapping (mapid);
+
+  if (m != NULL)
+    {
+      list_remove (&m->elem);
+      unmap (m);
+    }
+}
+
+/* Unmaps all of the current process's mappings, at exit. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_pop_front (mappings), struct mapping, elem));
+}
+
+/* Writes back the written, resident pages of mappings of FILE
+   that overlap the SIZE bytes starting at offset OFS, so that a
+   read of those bytes sees stores made through the mappings.
+   The caller must hold filesys_lock. */
+void
+mmap_flush_range (struct file *file, off_t ofs, off_t size)
+{
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+  if (mapping_cnt > 0 && size > 0)
+    frame_sync_mmap (file_get_inode (file), ofs, size, NULL);
+}
+
+/* Copies the SIZE bytes in BUFFER, just written to FILE at offset
+   OFS, into the resident pages of mappings of FILE that overlap
+   them, so that the mappings show the write.  The caller must
+   hold filesys_lock. */
+void
+mmap_update_range (struct file *file, off_t ofs, const void *buffer,
+                   off_t size)
+{
+  ASSERT (lock_held_by_current_thread (&filesys_lock));
+
+  if (mapping_cnt > 0 && size > 0)
+    frame_sync_mmap (file_get_inode (file), ofs, size, buffer);
+}
+
+/* Returns the current process's mapping MAPID, or a null
+   pointer if there is none. */
+static struct mapping *
+lookup_mapping (mapid_t mapid)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings); e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapid)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes M's pages, writing back dirty ones, then closes its
+   file and frees it.  M must not be in a list. */
+static void
+unmap (struct mapping *m)
+{
+  struct pagedir_batch batch;
+  size_t i;
+
+  pagedir_batch_begin (&batch);
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (page_lookup (m->base + i * PGSIZE), &batch);
+  pagedir_batch_end (&batch);
+
+  lock_acquire (&filesys_lock);
+  file_close (m->file);
+  mapping_cnt--;
+  lock_release (&filesys_lock);
+  free (m);
+}
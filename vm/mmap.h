@@ -0,0 +1,21 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include "filesys/off_t.h"
+#include "userprog/syscall.h"
+
+struct file;
+
+/* Returned by mmap_map() on failure. */
+#define MAP_FAILED ((mapid_t) -1)
+
+void mmap_init (void);
+mapid_t mmap_map (struct file *, void *addr);
+void mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+/* Coherence with read() and write(). */
+void mmap_flush_range (struct file *, off_t ofs, off_t size);
+void mmap_update_range (struct file *, off_t ofs, const void *, off_t size);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,768 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process's supp_page_table records, for every page of its
+   address space, where the page's contents come from: a range of
+   a file (an executable segment) or zeros.  The stack starts
+   out as a single page and grows downward, a zero page at a
+   time, as the process touches the pages below it, up to a
+   limit set with -stack.  Pages are not given frames up front;
+   page_in() loads a page the first time it is touched, from the
+   page fault handler or when a system call validates a user
+   buffer.
+
+   A zero page that the process reads before it writes it is
+   mapped read-only to a single page of zeros shared by everyone,
+   and only gets a frame of its own when the process first
+   writes it.  Pages that a system call validates always get
+   their own frames, since they are pinned for the call and the
+   shared zero page has no frame to pin.
+
+   A page fault by the process also maps the other pages of the
+   surrounding window of pages that can be mapped without disk
+   I/O or eviction: executable text that another process has
+   resident, and file pages that are in the file system's page
+   cache, as long as free frames are at hand.  A process that
+   touches its pages in order then takes one fault per window
+   rather than one per page.  The window size is set with
+   -fault-around.
+
+   The frame table may take a page's frame back at any time
+   unless the page is pinned, as the buffers of the running
+   system call are.  A page that has not been written since it
+   was loaded is simply dropped, since it can be loaded again.
+   A page that has been written is written to swap, after which
+   it is a PAGE_SWAP page.  A swapped-in page keeps its slot, so
+   that it can be dropped again if it is not written before its
+   next eviction.
+
+   Read-only pages of executables are not given frames of their
+   own: the frame table keeps one frame per page of an executable
+   for all of the processes running it (see frame.c).
+
+   Pages of memory-mapped files (see mmap.c) never go to swap:
+   a written one is written back to its file instead, through
+   the file system's page cache. */
+
+/* Default limit on the size of a user stack, in pages. */
+#define DEFAULT_STACK_PAGES 2048        /* 8 MB. */
+
+/* How far below the stack pointer an access may be and still
+   grow the stack: PUSHA writes 32 bytes below esp before it
+   moves esp. */
+#define STACK_SLOP 32
+
+/* Limit on the size of a user stack, in pages. */
+static size_t stack_pages = DEFAULT_STACK_PAGES;
+
+/* Default number of pages in a fault-around window. */
+#define DEFAULT_FAULT_AROUND 16
+
+/* Number of pages in a fault-around window; 0 or 1 disables
+   faulting around. */
+static size_t fault_around_pages = DEFAULT_FAULT_AROUND;
+
+/* Page of zeros mapped read-only for zero pages not yet
+   written. */
+static void *zero_page;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static void destroy_page (struct hash_elem *, void *aux);
+static struct page *add_page (void *upage, bool writable, enum page_type);
+static bool load_page (struct page *, void *kpage);
+static void write_back (struct page *, const void *kpage);
+static void release_page (struct page *, struct pagedir_batch *);
+static void swap_in (struct page *);
+static bool share_in (struct page *);
+static bool map_resident (struct page *);
+
+/* Initializes the shared zero page. */
+void
+page_init (void)
+{
+  zero_page = palloc_get_page (PAL_ZERO);
+  if (zero_page == NULL)
+    PANIC ("no memory for zero page");
+}
+
+/* Initializes the current process's supplemental page table. */
+void
+page_table_init (void)
+{
+  struct thread *t = thread_current ();
+
+  hash_init (&t->supp_page_table, page_hash, page_less, NULL);
+  list_init (&t->pinned_pages);
+}
+
+/* Destroys the current process's supplemental page table,
+   unmapping its pages and freeing their frames. */
+void
+page_table_destroy (void)
+{
+  struct hash *h = &thread_current ()->supp_page_table;
+  struct pagedir_batch batch;
+
+  /* Pass the batch to destroy_page() as the table's auxiliary
+     data. */
+  pagedir_batch_begin (&batch);
+  h->aux = &batch;
+  hash_destroy (h, destroy_page);
+  pagedir_batch_end (&batch);
+}
+
+/* Adds page UPAGE to the current process, to be filled on first
+   touch with READ_BYTES bytes read from FILE starting at offset
+   OFS and zeros after them.  FILE must stay open as long as the
+   page exists.  Returns true if successful, false if UPAGE is
+   already part of the address space or memory is short. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs, size_t read_bytes,
+               bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = add_page (upage, writable, PAGE_FILE);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds page UPAGE to the current process, to be zeroed on first
+   touch.  Returns true if successful, false if UPAGE is already
+   part of the address space or memory is short. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return add_page (upage, writable, PAGE_ZERO) != NULL;
+}
+
+/* Adds page UPAGE to the current process as page of a mapped
+   file: it is filled on first touch with READ_BYTES bytes read
+   from FILE starting at offset OFS and zeros after them, and
+   written back there if the process writes it.  FILE must stay
+   open as long as the page exists.  Returns true if successful,
+   false if UPAGE is already part of the address space or memory
+   is short. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs, size_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = add_page (upage, true, PAGE_MMAP);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Removes page P from the current process's address space,
+   writing it back first if it is a mapped file page that has
+   been written.  The TLB invalidation for P is left to BATCH. */
+void
+page_remove (struct page *p, struct pagedir_batch *batch)
+{
+  hash_delete (&thread_current ()->supp_page_table, &p->elem);
+  release_page (p, batch);
+}
+
+/* Returns the current process's page containing ADDR, or a null
+   pointer if ADDR is not part of its address space. */
+struct page *
+page_lookup (const void *addr)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = pg_round_down (addr);
+  e = hash_find (&thread_current ()->supp_page_table, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Makes the current process's page containing ADDR resident:
+   allocates a frame, fills it, and maps it.  A zero page mapped
+   to the shared zero page gets a frame of its own.  Returns true
+   if successful, false if ADDR is not part of the address space
+   or the page could not be loaded. */
+bool
+page_in (const void *addr)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (addr);
+  struct frame *f;
+  void *kpage;
+
+  if (p == NULL)
+    return false;
+  kpage = pagedir_get_page (t->pagedir, p->upage);
+  if (kpage == zero_page)
+    pagedir_clear_page (t->pagedir, p->upage);
+  else if (kpage != NULL)
+    return true;
+  if (p->type == PAGE_FILE && !p->writable)
+    return share_in (p);
+
+  f = frame_alloc (p);
+  if (f == NULL)
+    return false;
+  if (pagedir_get_page (t->pagedir, p->upage) != NULL)
+    {
+      /* An eviction of P that we waited for in frame_alloc()
+         failed and left P where it was. */
+      frame_unpin (f);
+      return true;
+    }
+  if (p->type == PAGE_SWAP)
+    swap_in (p);
+  else if (!load_page (p, f->kpage))
+    {
+      frame_free (p);
+      return false;
+    }
+  if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, p->writable))
+    {
+      frame_free (p);
+      return false;
+    }
+  frame_unpin (f);
+  return true;
+}
+
+/* Sets the number of pages in a fault-around window.  Called
+   while parsing the kernel command line. */
+void
+page_set_fault_around (int pages)
+{
+  if (pages >= 0)
+    fault_around_pages = pages;
+}
+
+/* Maps the current process's pages in the window around ADDR,
+   where the process just took a page fault, that can be mapped
+   without disk I/O. */
+void
+page_fault_around (const void *addr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *upage = pg_round_down (addr);
+  uint8_t *start;
+  size_t i;
+
+  if (fault_around_pages <= 1)
+    return;
+  start = upage - pg_no (upage) % fault_around_pages * PGSIZE;
+  for (i = 0; i < fault_around_pages; i++)
+    {
+      uint8_t *neighbour = start + i * PGSIZE;
+      struct page *p;
+
+      if (!is_user_vaddr (neighbour))
+        break;
+      if (neighbour == upage)
+        continue;
+      p = page_lookup (neighbour);
+      if (p != NULL && pagedir_get_page (pd, neighbour) == NULL)
+        map_resident (p);
+    }
+}
+
+/* Sets the most pages a user stack may grow to.  Called while
+   parsing the kernel command line. */
+void
+page_set_stack_limit (int pages)
+{
+  if (pages > 0 && (size_t) pages < (size_t) PHYS_BASE / PGSIZE)
+    stack_pages = pages;
+}
+
+/* Returns true if ADDR lies in the part of the user address
+   space that the stack may grow into. */
+bool
+page_is_stack (const void *addr)
+{
+  return (is_user_vaddr (addr)
+          && (const uint8_t *) addr >= (uint8_t *) PHYS_BASE
+                                       - stack_pages * PGSIZE);
+}
+
+/* Grows the current process's stack to cover ADDR, a user
+   address that was touched while the stack pointer was ESP, if
+   the access is a plausible stack access: within the stack's
+   limit and no more than STACK_SLOP bytes below ESP.  Returns
+   true if the page containing ADDR is now resident, false if
+   ADDR is not a stack access. */
+bool
+page_grow_stack (const void *addr, const void *esp)
+{
+  void *upage = pg_round_down (addr);
+
+  if (!page_is_stack (addr)
+      || (const uint8_t *) addr < (const uint8_t *) esp - STACK_SLOP)
+    return false;
+  if (page_lookup (upage) == NULL && !page_add_zero (upage, true))
+    return false;
+  return page_in (upage);
+}
+
+/* Maps the current process's page containing ADDR, if it is a
+   zero page that is not resident, read-only to the shared zero
+   page.  Returns true if successful, false if the page must be
+   brought in with page_in() instead. */
+bool
+page_map_zero (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+
+  return (p != NULL && p->type == PAGE_ZERO && p->frame == NULL
+          && pagedir_set_page (p->owner->pagedir, p->upage, zero_page,
+                               false));
+}
+
+/* Gives the current process's page containing ADDR a frame of
+   its own if the page is writable and mapped to the shared zero
+   page, for a write to it.  Returns true if successful, false
+   if the write is not allowed. */
+bool
+page_copy_on_write (const void *addr)
+{
+  struct page *p = page_lookup (addr);
+
+  return (p != NULL && p->writable
+          && pagedir_get_page (p->owner->pagedir, p->upage) == zero_page
+          && page_in (addr));
+}
+
+/* Brings in and pins the current process's pages that BUFFER,
+   SIZE bytes long, overlaps, so that the running system call can
+   touch them without faulting.  They are unpinned by
+   page_unpin_all() when the system call returns.  Returns false
+   if part of BUFFER is not in the address space or could not be
+   brought in, leaving the pages pinned so far pinned. */
+bool
+page_pin_buffer (const void *buffer, size_t size)
+{
+  struct thread *t = thread_current ();
+  const uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  for (upage = pg_round_down (buffer);
+       upage <= (const uint8_t *) buffer + size - 1; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (upage);
+      if (p == NULL)
+        return false;
+      if (p->pinned)
+        continue;
+
+      /* Pin before bringing the page in, so that it cannot be
+         evicted again in between. */
+      frame_pin_page (p);
+      list_push_back (&t->pinned_pages, &p->pin_elem);
+      if (!page_in (upage))
+        return false;
+    }
+  return true;
+}
+
+/* Unpins all of the pages pinned by page_pin_buffer(). */
+void
+page_unpin_all (void)
+{
+  struct list *pinned = &thread_current ()->pinned_pages;
+
+  while (!list_empty (pinned))
+    {
+      struct list_elem *e = list_pop_front (pinned);
+      list_entry (e, struct page, pin_elem)->pinned = false;
+    }
+}
+
+/* Returns true if P has been accessed since this function last
+   looked at it, clearing its accessed bit as part of BATCH.  The
+   caller must hold the frame table's lock. */
+bool
+page_accessed_recently (struct page *p, struct pagedir_batch *batch)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  if (!pagedir_is_accessed (pd, p->upage))
+    return false;
+  pagedir_batch_set_accessed (batch, pd, p->upage, false);
+  return true;
+}
+
+/* Returns true if resident page P has been written since it was
+   loaded, so that evicting it means writing it to swap.  Mapped
+   file pages never do, since page_out() writes them back to
+   their files. */
+bool
+page_needs_write (struct page *p)
+{
+  return (p->type != PAGE_MMAP
+          && pagedir_is_dirty (p->owner->pagedir, p->upage));
+}
+
+/* Evicts resident page P from its frame if it is not pinned and
+   its contents can be recreated, unmapping it so that the next
+   access faults it back in.  A written page of a mapped file is
+   written back to the file.  Returns true if successful, false
+   if P must stay or be written to swap first.  The caller must
+   hold the frame table's lock. */
+bool
+page_out (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+  enum intr_level old_level;
+  bool dirty;
+
+  if (p->pinned)
+    return false;
+
+  if (p->type == PAGE_MMAP)
+    {
+      /* A thread that holds the file system lock may be waiting
+         for the frame table's lock, so only try for it. */
+      bool held = lock_held_by_current_thread (&filesys_lock);
+
+      if (!held && !lock_try_acquire (&filesys_lock))
+        return false;
+      old_level = intr_disable ();
+      dirty = pagedir_is_dirty (pd, p->upage);
+      pagedir_clear_page (pd, p->upage);
+      intr_set_level (old_level);
+      if (dirty)
+        write_back (p, p->frame->kpage);
+      if (!held)
+        lock_release (&filesys_lock);
+
+      p->frame = NULL;
+      return true;
+    }
+
+  /* Check for writes and unmap in one step, so that the owner
+     cannot write the page in between. */
+  old_level = intr_disable ();
+  dirty = pagedir_is_dirty (pd, p->upage);
+  if (!dirty)
+    pagedir_clear_page (pd, p->upage);
+  intr_set_level (old_level);
+  if (dirty)
+    return false;
+
+  p->frame = NULL;
+  return true;
+}
+
+/* Evicts the CNT resident PAGES, which must not be pinned, by
+   writing them to swap, as many as possible in one request.
+   Returns the number evicted, which are PAGES[0] through
+   PAGES[N - 1]; the rest stay resident.  The caller must hold
+   the frame table's lock and free the evicted pages' frames. */
+size_t
+page_swap_out (struct page *pages[], size_t cnt)
+{
+  void *kpages[SWAP_CLUSTER];
+  struct pagedir_batch batch;
+  size_t slot, written, i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  /* Unmap first, so that the copies written include every write
+     made before the owner can fault on the page. */
+  pagedir_batch_begin (&batch);
+  for (i = 0; i < cnt; i++)
+    {
+      pagedir_batch_clear_page (&batch, pages[i]->owner->pagedir,
+                                pages[i]->upage);
+      kpages[i] = pages[i]->frame->kpage;
+    }
+  pagedir_batch_end (&batch);
+
+  written = swap_write (pages, kpages, cnt, &slot);
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *p = pages[i];
+      if (i < written)
+        {
+          if (p->swap_slot != SWAP_NONE)
+            swap_free (p->swap_slot);
+          p->type = PAGE_SWAP;
+          p->swap_slot = slot + i;
+          p->frame = NULL;
+        }
+      else
+        {
+          /* Swap is full.  Map P again, still marked dirty. */
+          uint32_t *pd = p->owner->pagedir;
+          if (pagedir_set_page (pd, p->upage, kpages[i], p->writable))
+            pagedir_set_dirty (pd, p->upage, true);
+        }
+    }
+  return written;
+}
+
+/* Brings resident mapped file page P in line with the SIZE bytes
+   of its file starting at offset OFS.  If DATA is nonnull, those
+   bytes were just written to the file from DATA, and the part of
+   P they overlap is overwritten with them.  Otherwise they are
+   about to be read, and P is written back to the file if it has
+   been written.  The caller must hold the frame table's lock and
+   the file system lock. */
+void
+page_sync_mmap (struct page *p, off_t ofs, off_t size, const void *data)
+{
+  off_t start = ofs > p->ofs ? ofs : p->ofs;
+  off_t end = ofs + size < p->ofs + PGSIZE ? ofs + size : p->ofs + PGSIZE;
+  uint32_t *pd = p->owner->pagedir;
+
+  ASSERT (p->type == PAGE_MMAP && p->frame != NULL);
+
+  if (start >= end)
+    return;
+  if (data != NULL)
+    memmove ((uint8_t *) p->frame->kpage + (start - p->ofs),
+             (const uint8_t *) data + (start - ofs), end - start);
+  else if (pagedir_is_dirty (pd, p->upage))
+    {
+      pagedir_set_dirty (pd, p->upage, false);
+      write_back (p, p->frame->kpage);
+    }
+}
+
+/* Creates and inserts a page of the given TYPE at UPAGE in the
+   current process's table.  Returns the new page, or a null
+   pointer on failure. */
+static struct page *
+add_page (void *upage, bool writable, enum page_type type)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->owner = thread_current ();
+  p->upage = upage;
+  p->writable = writable;
+  p->type = type;
+  p->frame = NULL;
+  p->share = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->pinned = false;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  if (hash_insert (&thread_current ()->supp_page_table, &p->elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Fills KPAGE with P's contents.  Returns true if successful,
+   false on a short read. */
+static bool
+load_page (struct page *p, void *kpage)
+{
+  size_t read_bytes = p->type != PAGE_ZERO ? p->read_bytes : 0;
+
+  if (read_bytes > 0)
+    {
+      /* A system call that touches a page that is not resident
+         may already hold the file system lock. */
+      bool held = lock_held_by_current_thread (&filesys_lock);
+      off_t n;
+
+      if (!held)
+        lock_acquire (&filesys_lock);
+      n = file_read_at (p->file, kpage, read_bytes, p->ofs);
+      if (!held)
+        lock_release (&filesys_lock);
+      if (n != (off_t) read_bytes)
+        return false;
+    }
+  memset ((uint8_t *) kpage + read_bytes, 0, PGSIZE - read_bytes);
+  return true;
+}
+
+/* Maps read-only executable page P to the frame that the
+   processes running the executable share for it, reading it in
+   if none of them has it resident.  Returns true if successful,
+   false if memory is short or the page could not be loaded. */
+static bool
+share_in (struct page *p)
+{
+  struct frame *f;
+  bool fill, loaded, mapped;
+
+  f = frame_share_get (p, &fill);
+  if (f == NULL)
+    return false;
+  loaded = !fill || load_page (p, f->kpage);
+  mapped = loaded && pagedir_set_page (p->owner->pagedir, p->upage,
+                                       f->kpage, false);
+  frame_share_put (p, loaded);
+  return mapped;
+}
+
+/* Maps non-resident page P if that takes no disk I/O and no
+   eviction, for faulting around.  Returns true if successful. */
+static bool
+map_resident (struct page *p)
+{
+  struct frame *f;
+
+  if (p->type == PAGE_FILE && !p->writable)
+    return frame_share_map (p);
+  if ((p->type != PAGE_FILE && p->type != PAGE_MMAP) || p->frame != NULL
+      || !inode_is_cached (file_get_inode (p->file), p->ofs))
+    return false;
+
+  f = frame_try_alloc (p);
+  if (f == NULL)
+    return false;
+  if (!load_page (p, f->kpage)
+      || !pagedir_set_page (p->owner->pagedir, p->upage, f->kpage,
+                            p->writable))
+    {
+      frame_free (p);
+      return false;
+    }
+  frame_unpin (f);
+  return true;
+}
+
+/* Writes P's READ_BYTES bytes back to its file from KPAGE. */
+static void
+write_back (struct page *p, const void *kpage)
+{
+  bool held = lock_held_by_current_thread (&filesys_lock);
+
+  if (!held)
+    lock_acquire (&filesys_lock);
+  file_write_at (p->file, kpage, p->read_bytes, p->ofs);
+  if (!held)
+    lock_release (&filesys_lock);
+}
+
+/* Reads swapped-out page P into its frame, which the caller has
+   allocated.  Also reads in, with the same request, the
+   process's pages in the slots right after P's, as long as free
+   frames are at hand for them, and maps them. */
+static void
+swap_in (struct page *p)
+{
+  struct page *more[SWAP_CLUSTER - 1];
+  void *kpages[SWAP_CLUSTER];
+  size_t cnt, i;
+
+  ASSERT (p->swap_slot != SWAP_NONE);
+
+  cnt = swap_neighbours (p->swap_slot, more, SWAP_CLUSTER - 1);
+  kpages[0] = p->frame->kpage;
+  for (i = 0; i < cnt; i++)
+    {
+      struct frame *f = frame_try_alloc (more[i]);
+      if (f == NULL)
+        break;
+      kpages[i + 1] = f->kpage;
+    }
+  cnt = i;
+
+  swap_read (p->swap_slot, cnt + 1, kpages);
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *q = more[i];
+      if (pagedir_set_page (q->owner->pagedir, q->upage, q->frame->kpage,
+                            q->writable))
+        frame_unpin (q->frame);
+      else
+        frame_free (q);
+    }
+}
+
+/* Unmaps and frees page P, which must already be out of its
+   owner's table, writing it back first if it is a written page
+   of a mapped file.  P's frame may be reused before BATCH ends,
+   which is safe only because the owner is the current thread,
+   running in the kernel, and switching threads flushes the
+   TLB. */
+static void
+release_page (struct page *p, struct pagedir_batch *batch)
+{
+  frame_share_release (p);
+  if (frame_pin (p))
+    {
+      uint32_t *pd = p->owner->pagedir;
+
+      if (p->type == PAGE_MMAP && pagedir_is_dirty (pd, p->upage))
+        write_back (p, p->frame->kpage);
+      pagedir_batch_clear_page (batch, pd, p->upage);
+      frame_free (p);
+    }
+  else
+    {
+      /* P may be mapped to the shared zero page, which must not
+         be freed along with the page directory. */
+      pagedir_batch_clear_page (batch, p->owner->pagedir, p->upage);
+    }
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  free (p);
+}
+
+/* Unmaps and frees the page whose element is E, as part of
+   batch AUX. */
+static void
+destroy_page (struct hash_elem *e, void *aux)
+{
+  release_page (hash_entry (e, struct page, elem), aux);
+}
+
+/* Returns a hash value for the page whose element is E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, elem);
+  const struct page *b = hash_entry (b_, struct page, elem);
+
+  return a->upage < b->upage;
+}
@@ -0,0 +1,84 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct pagedir_batch;
+struct share;
+struct thread;
+
+/* Where a user page's contents come from when it is not
+   resident. */
+enum page_type
+  {
+    PAGE_FILE,                  /* Read from a file, rest zeroed. */
+    PAGE_MMAP,                  /* Mapped file, written back to it. */
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP                   /* In swap slot SWAP_SLOT. */
+  };
+
+/* A page of a process's address space, as recorded in its
+   supplemental page table. */
+struct page
+  {
+    struct hash_elem elem;      /* Element in supp_page_table. */
+    struct thread *owner;       /* Process whose page this is. */
+    void *upage;                /* User virtual address. */
+    bool writable;              /* May the process write it? */
+    enum page_type type;        /* Origin of its contents. */
+    struct frame *frame;        /* Frame holding it, if resident. */
+    struct share *share;        /* Shared text it maps, or null. */
+    struct list_elem share_elem; /* Element in share's pages. */
+    size_t swap_slot;           /* Swap slot with a copy, or SWAP_NONE. */
+
+    /* Pinned for the current system call. */
+    bool pinned;                /* Kept resident? */
+    struct list_elem pin_elem;  /* Element in owner's pinned_pages. */
+
+    /* PAGE_FILE and PAGE_MMAP: READ_BYTES bytes at offset OFS in
+       FILE, followed by zeros to the end of the page. */
+    struct file *file;
+    off_t ofs;
+    size_t read_bytes;
+  };
+
+void page_init (void);
+void page_table_init (void);
+void page_table_destroy (void);
+
+bool page_add_file (void *upage, struct file *, off_t ofs, size_t read_bytes,
+                    bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs, size_t read_bytes);
+void page_remove (struct page *, struct pagedir_batch *);
+struct page *page_lookup (const void *addr);
+bool page_in (const void *addr);
+bool page_map_zero (const void *addr);
+bool page_copy_on_write (const void *addr);
+void page_set_fault_around (int pages);
+void page_fault_around (const void *addr);
+
+/* Stack growth. */
+void page_set_stack_limit (int pages);
+bool page_is_stack (const void *addr);
+bool page_grow_stack (const void *addr, const void *esp);
+
+/* Keeping system call buffers resident. */
+bool page_pin_buffer (const void *, size_t size);
+void page_unpin_all (void);
+
+/* Eviction, for the frame table. */
+bool page_accessed_recently (struct page *, struct pagedir_batch *);
+bool page_needs_write (struct page *);
+bool page_out (struct page *);
+size_t page_swap_out (struct page *pages[], size_t cnt);
+
+/* Mapped file coherence, for the frame table. */
+void page_sync_mmap (struct page *, off_t ofs, off_t size, const void *data);
+
+#endif /* vm/page.h */
@@ -0,0 +1,243 @@
+#include "vm/swap.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+#include "vm/zswap.h"
+
+/* Swap space.
+
+   The swap device is divided into page-sized slots of
+   SLOT_SECTORS sectors each, tracked by a bitmap.  Evicted pages
+   are written in clusters of up to SWAP_CLUSTER pages to
+   consecutive slots with a single request, and a fault on a
+   swapped page reads it in together with the pages of the same
+   process in the slots right after it, also with one request.
+   Both go through a bounce buffer, since the frames involved are
+   not contiguous.
+
+   Slots are allocated next-fit: the search for free slots starts
+   where the last allocation ended, so that it normally finds
+   them at once instead of rescanning the full part of the
+   bitmap every time.
+
+   In front of the device sits a compressed swap cache (see
+   zswap.c).  A page that it accepts still gets a slot, but is
+   not written to the device; the rest of a cluster is written
+   in runs of consecutive slots, one request per run, and read
+   back the same way. */
+
+/* Sectors per slot. */
+#define SLOT_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;       /* Swap device, or null. */
+static struct bitmap *used_slots;       /* One bit per slot, true if used. */
+static struct page **slot_pages;        /* Page in each used slot. */
+static size_t next_slot;                /* Where to look for free slots. */
+static uint8_t *bounce;                 /* SWAP_CLUSTER pages of buffer. */
+static struct lock swap_lock;           /* Protects all of the above. */
+
+/* Statistics, for the swap device. */
+static unsigned long long out_cnt, in_cnt;       /* Pages. */
+static unsigned long long write_cnt, read_cnt;   /* Requests. */
+
+static size_t allocate_slots (size_t cnt);
+static void write_run (size_t slot, size_t cnt);
+static void read_run (size_t slot, size_t cnt, void *const kpages[]);
+
+/* Sets up swap space on the BLOCK_SWAP device, if there is
+   one. */
+void
+swap_init (void)
+{
+  size_t slot_cnt;
+
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    return;
+
+  slot_cnt = block_size (swap_device) / SLOT_SECTORS;
+  used_slots = bitmap_create (slot_cnt);
+  slot_pages = malloc (slot_cnt * sizeof *slot_pages);
+  bounce = palloc_get_multiple (0, SWAP_CLUSTER);
+  if (used_slots == NULL || slot_pages == NULL || bounce == NULL)
+    PANIC ("no memory for swap table");
+  zswap_init (slot_cnt);
+}
+
+/* Writes the contents of as many of the CNT pages as fit, up to
+   SWAP_CLUSTER, from the frames at KPAGES into consecutive free
+   slots, storing those that it can in the compressed swap cache
+   and writing the others to the device with one request per run
+   of consecutive slots.  Returns the number of pages written,
+   the first PAGES[0] through PAGES[N - 1], and stores the first
+   slot into *SLOTP; page I is in slot *SLOTP + I.  Returns 0 if
+   swap is full or there is no swap device. */
+size_t
+swap_write (struct page *const pages[], void *const kpages[], size_t cnt,
+            size_t *slotp)
+{
+  size_t slot = SWAP_NONE;
+  size_t i;
+
+  if (swap_device == NULL)
+    return 0;
+  if (cnt > SWAP_CLUSTER)
+    cnt = SWAP_CLUSTER;
+
+  lock_acquire (&swap_lock);
+  for (; cnt > 0; cnt /= 2)
+    {
+      slot = allocate_slots (cnt);
+      if (slot != SWAP_NONE)
+        break;
+    }
+  if (cnt > 0)
+    {
+      size_t run = 0;
+
+      for (i = 0; i < cnt; i++)
+        {
+          slot_pages[slot + i] = pages[i];
+          if (zswap_store (slot + i, kpages[i]))
+            {
+              write_run (slot + i - run, run);
+              run = 0;
+            }
+          else
+            memcpy (bounce + run++ * PGSIZE, kpages[i], PGSIZE);
+        }
+      write_run (slot + cnt - run, run);
+      *slotp = slot;
+    }
+  lock_release (&swap_lock);
+  return cnt;
+}
+
+/* Stores into PAGES the pages of the running process in the
+   slots following SLOT that are not resident, stopping at the
+   first slot that holds anything else or after MAX pages.
+   Returns the number of pages stored. */
+size_t
+swap_neighbours (size_t slot, struct page *pages[], size_t max)
+{
+  struct thread *cur = thread_current ();
+  size_t n = 0;
+
+  lock_acquire (&swap_lock);
+  while (n < max && slot + 1 + n < bitmap_size (used_slots)
+         && bitmap_test (used_slots, slot + 1 + n))
+    {
+      struct page *p = slot_pages[slot + 1 + n];
+      if (p->owner != cur || p->frame != NULL)
+        break;
+      pages[n++] = p;
+    }
+  lock_release (&swap_lock);
+  return n;
+}
+
+/* Reads the CNT consecutive slots starting at SLOT into the
+   frames at KPAGES, from the compressed swap cache where
+   possible and otherwise from the device with one request per
+   run of consecutive slots.  The slots stay allocated until
+   freed with swap_free(). */
+void
+swap_read (size_t slot, size_t cnt, void *const kpages[])
+{
+  size_t run = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_all (used_slots, slot, cnt));
+  for (i = 0; i < cnt; i++)
+    if (zswap_load (slot + i, kpages[i]))
+      {
+        read_run (slot + i - run, run, kpages + i - run);
+        run = 0;
+      }
+    else
+      run++;
+  read_run (slot + cnt - run, run, kpages + cnt - run);
+  lock_release (&swap_lock);
+}
+
+/* Frees SLOT. */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (used_slots, slot));
+  bitmap_reset (used_slots, slot);
+  zswap_drop (slot);
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  if (swap_device == NULL)
+    return;
+  printf ("Swap: %llu pages out in %llu writes, %llu pages in in %llu reads,"
+          " %zu of %zu slots used\n", out_cnt, write_cnt, in_cnt, read_cnt,
+          bitmap_count (used_slots, 0, bitmap_size (used_slots), true),
+          bitmap_size (used_slots));
+  zswap_print_stats ();
+}
+
+/* Allocates CNT consecutive free slots, searching from
+   next_slot onward and then from the start, and returns the
+   first, or SWAP_NONE if there is no such run.  The caller must
+   hold swap_lock. */
+static size_t
+allocate_slots (size_t cnt)
+{
+  size_t slot = bitmap_scan_and_flip (used_slots, next_slot, cnt, false);
+  if (slot == SWAP_NONE && next_slot > 0)
+    slot = bitmap_scan_and_flip (used_slots, 0, cnt, false);
+  if (slot != SWAP_NONE)
+    next_slot = (slot + cnt) % bitmap_size (used_slots);
+  return slot;
+}
+
+/* Writes the first CNT pages in the bounce buffer to the CNT
+   slots starting at SLOT with one request.  The caller must hold
+   swap_lock. */
+static void
+write_run (size_t slot, size_t cnt)
+{
+  if (cnt == 0)
+    return;
+  block_write_multiple (swap_device, slot * SLOT_SECTORS,
+                        cnt * SLOT_SECTORS, bounce);
+  out_cnt += cnt;
+  write_cnt++;
+}
+
+/* Reads the CNT slots starting at SLOT from the device with one
+   request into the frames at KPAGES.  The caller must hold
+   swap_lock. */
+static void
+read_run (size_t slot, size_t cnt, void *const kpages[])
+{
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  block_read_multiple (swap_device, slot * SLOT_SECTORS,
+                       cnt * SLOT_SECTORS, bounce);
+  for (i = 0; i < cnt; i++)
+    memcpy (kpages[i], bounce + i * PGSIZE, PGSIZE);
+  in_cnt += cnt;
+  read_cnt++;
+}
@@ -0,0 +1,23 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <bitmap.h>
+#include <stddef.h>
+
+struct page;
+
+/* Swap slot number that stands for no slot. */
+#define SWAP_NONE BITMAP_ERROR
+
+/* Most pages written or read in one request. */
+#define SWAP_CLUSTER 8
+
+void swap_init (void);
+size_t swap_write (struct page *const pages[], void *const kpages[],
+                   size_t cnt, size_t *slotp);
+size_t swap_neighbours (size_t slot, struct page *pages[], size_t max);
+void swap_read (size_t slot, size_t cnt, void *const kpages[]);
+void swap_free (size_t slot);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */
@@ -0,0 +1,221 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Compressed swap cache.
+
+   Pages on their way to swap are first compressed into a pool of
+   kernel memory, and only pages that do not compress well, or
+   that do not fit once the pool is full, are written to the swap
+   device.  A page in the pool is read back by decompressing it,
+   with no disk I/O at all.  Pages that consist of a single
+   repeated word, most often zeros, take no pool space: only the
+   word is kept.
+
+   The pool is a contiguous run of kernel pages divided into
+   CHUNK_SIZE-byte chunks, allocated first-fit with a bitmap;
+   compressed pages take consecutive chunks.  It is indexed by
+   swap slot, since every page in it also has a slot reserved on
+   the swap device, so that it can be written there instead.
+
+   These functions are called only by swap.c, with its lock
+   held, which also protects the pool. */
+
+/* Size of an allocation unit in the pool. */
+#define CHUNK_SIZE 64
+
+/* Default pool size, in pages. */
+#define DEFAULT_POOL_PAGES 32
+
+/* Largest compressed size worth keeping: a page must compress to
+   at most three quarters of its size to be stored. */
+#define MAX_STORED (PGSIZE / 4 * 3)
+
+/* A swap slot's entry in the pool. */
+struct zentry
+  {
+    bool stored;                /* Page is in the pool? */
+    uint16_t size;              /* Compressed size, 0 if same-filled. */
+    size_t chunk;               /* First chunk, if SIZE > 0. */
+    uint32_t fill;              /* Repeated word, if SIZE == 0. */
+  };
+
+static size_t pool_pages = DEFAULT_POOL_PAGES;  /* Pool size. */
+static uint8_t *pool;                   /* Pool memory, or null. */
+static struct bitmap *used_chunks;      /* One bit per chunk. */
+static struct zentry *entries;          /* One per swap slot. */
+
+/* Scratch space for compression. */
+static uint8_t buffer[MAX_STORED];
+static uint16_t hash[LZ_HASH_SIZE];
+
+/* Statistics. */
+static unsigned long long store_cnt, same_cnt, load_cnt;
+static unsigned long long reject_cnt, full_cnt;
+static unsigned long long compressed_bytes;     /* Of pages stored. */
+
+static bool same_filled (const void *kpage, uint32_t *fill);
+
+/* Sets the pool size, in pages.  0 disables the compressed swap
+   cache.  Called while parsing the kernel command line. */
+void
+zswap_set_pool_size (int pages)
+{
+  if (pages >= 0)
+    pool_pages = pages;
+}
+
+/* Allocates the pool and per-slot entries for SLOT_CNT swap
+   slots.  If the pool cannot be had at its full size, makes do
+   with a smaller one. */
+void
+zswap_init (size_t slot_cnt)
+{
+  for (; pool_pages > 0; pool_pages /= 2)
+    {
+      pool = palloc_get_multiple (0, pool_pages);
+      if (pool != NULL)
+        break;
+    }
+  if (pool == NULL)
+    return;
+
+  used_chunks = bitmap_create (pool_pages * PGSIZE / CHUNK_SIZE);
+  entries = calloc (slot_cnt, sizeof *entries);
+  if (used_chunks == NULL || entries == NULL)
+    PANIC ("no memory for compressed swap cache");
+}
+
+/* Stores the page at KPAGE in the pool for swap slot SLOT, if it
+   compresses well enough and there is room.  Returns true if
+   successful, false if the page must be written to the swap
+   device instead. */
+bool
+zswap_store (size_t slot, const void *kpage)
+{
+  struct zentry *e;
+  size_t size, chunk;
+
+  if (pool == NULL)
+    return false;
+  e = &entries[slot];
+  ASSERT (!e->stored);
+
+  if (same_filled (kpage, &e->fill))
+    {
+      e->stored = true;
+      e->size = 0;
+      store_cnt++;
+      same_cnt++;
+      return true;
+    }
+
+  size = lz_compress (kpage, PGSIZE, buffer, sizeof buffer, hash);
+  if (size == 0)
+    {
+      reject_cnt++;
+      return false;
+    }
+  chunk = bitmap_scan_and_flip (used_chunks, 0,
+                                DIV_ROUND_UP (size, CHUNK_SIZE), false);
+  if (chunk == BITMAP_ERROR)
+    {
+      full_cnt++;
+      return false;
+    }
+  memcpy (pool + chunk * CHUNK_SIZE, buffer, size);
+  e->stored = true;
+  e->size = size;
+  e->chunk = chunk;
+  store_cnt++;
+  compressed_bytes += size;
+  return true;
+}
+
+/* Reads the page for swap slot SLOT into KPAGE if it is in the
+   pool.  The page stays in the pool until zswap_drop().  Returns
+   true if successful, false if the page is on the swap device
+   instead. */
+bool
+zswap_load (size_t slot, void *kpage)
+{
+  struct zentry *e;
+
+  if (pool == NULL || !entries[slot].stored)
+    return false;
+  e = &entries[slot];
+
+  if (e->size == 0)
+    {
+      uint32_t *p = kpage;
+      size_t i;
+
+      for (i = 0; i < PGSIZE / sizeof *p; i++)
+        p[i] = e->fill;
+    }
+  else
+    lz_decompress (pool + e->chunk * CHUNK_SIZE, kpage, PGSIZE);
+  load_cnt++;
+  return true;
+}
+
+/* Removes the page for swap slot SLOT from the pool, if it is
+   there. */
+void
+zswap_drop (size_t slot)
+{
+  struct zentry *e;
+
+  if (pool == NULL || !entries[slot].stored)
+    return;
+  e = &entries[slot];
+
+  if (e->size > 0)
+    bitmap_set_multiple (used_chunks, e->chunk,
+                         DIV_ROUND_UP (e->size, CHUNK_SIZE), false);
+  e->stored = false;
+}
+
+/* Prints compressed swap cache statistics. */
+void
+zswap_print_stats (void)
+{
+  unsigned long long compressed_cnt = store_cnt - same_cnt;
+
+  if (pool == NULL)
+    return;
+  printf ("Zswap: %llu pages stored (%llu same-filled, the rest compressed "
+          "to %llu%%), %llu page writes and %llu page reads saved, "
+          "%llu incompressible, %llu rejected for space, "
+          "%zu of %zu kB used\n",
+          store_cnt, same_cnt,
+          compressed_cnt > 0
+          ? compressed_bytes * 100 / (compressed_cnt * PGSIZE) : 0,
+          store_cnt, load_cnt, reject_cnt, full_cnt,
+          bitmap_count (used_chunks, 0, bitmap_size (used_chunks), true)
+          * CHUNK_SIZE / 1024,
+          pool_pages * PGSIZE / 1024);
+}
+
+/* Returns true if the page at KPAGE consists of one 32-bit word
+   repeated, storing the word into *FILL. */
+static bool
+same_filled (const void *kpage, uint32_t *fill)
+{
+  const uint32_t *p = kpage;
+  size_t i;
+
+  for (i = 1; i < PGSIZE / sizeof *p; i++)
+    if (p[i] != p[0])
+      return false;
+  *fill = p[0];
+  return true;
+}
@@ -0,0 +1,14 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void zswap_set_pool_size (int pages);
+void zswap_init (size_t slot_cnt);
+bool zswap_store (size_t slot, const void *kpage);
+bool zswap_load (size_t slot, void *kpage);
+void zswap_drop (size_t slot);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */